@@ -49,7 +49,7 @@
 
 namespace redseen::demos::particles {
 
-class TestWindowObserver : public engine::EventObserver {
+class TestWindowObserver {
   public:
     TestWindowObserver(std::shared_ptr<engine::Engine> engine,
                        std::shared_ptr<engine::Model> bullet_model)
@@ -60,11 +60,8 @@ class TestWindowObserver : public engine::EventObserver {
             -1.0f, 1.0f);
     }
 
-    engine::ObserverReturnSignal on_event(const engine::Event &event) override {
-        if (event.has_name(ui::window_event::KEY)) {
-            handleKeyEvent(static_cast<const ui::window_event::Key &>(event));
-        }
-
+    engine::ObserverReturnSignal on_event(const ui::window_event::Key &event) {
+        handleKeyEvent(event);
         return engine::ObserverReturnSignal::CONTINUE;
     }
 
@@ -187,9 +184,8 @@ int main() {
     auto observer = std::make_shared<demos::particles::TestWindowObserver>(
         engine, bullet_model);
 
-    engine->get_event_dispatcher()->register_observer(
-        "test_ui", {ui::window_event::KEY, ui::window_event::MOUSE_MOVE},
-        demos::particles::PRIORITY_CLASS, 0, observer);
+    engine->get_event_dispatcher()->register_observer<ui::window_event::Key>(
+        "test_ui", demos::particles::PRIORITY_CLASS, 0, observer);
 
     engine->get_event_producer_container()->add_producer("window", window);
 
@@ -0,0 +1,110 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace redseen {
+
+/** A bounded lock-free multi-producer single-consumer queue.
+Every cell carries a sequence number telling whether it's ready to be written
+or read, so producers only contend on a CAS of the enqueue position. The
+capacity is rounded up to a power of two. */
+template <class T> class MpscQueue {
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+
+    alignas(64) std::atomic<std::size_t> enqueue_pos = 0;
+    alignas(64) std::size_t dequeue_pos = 0;
+
+  public:
+    explicit MpscQueue(std::size_t capacity)
+        : cells(std::make_unique<Cell[]>(std::bit_ceil(capacity))),
+          mask(std::bit_ceil(capacity) - 1) {
+        for (std::size_t i = 0; i <= mask; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    std::size_t capacity() const { return mask + 1; }
+
+    /** Push a value. Safe to call from any thread.
+    Returns false if the queue is full. */
+    bool try_push(T value) {
+        std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        while (true) {
+            cell = &cells[pos & mask];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) -
+                        static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Pop a value. Must only be called from the consumer thread.
+    Returns false if the queue is empty. */
+    bool try_pop(T &out) {
+        Cell *cell = &cells[dequeue_pos & mask];
+        auto seq = cell->sequence.load(std::memory_order_acquire);
+
+        if (seq != dequeue_pos + 1)
+            return false;
+
+        out = std::move(cell->value);
+        cell->value = T{};
+        cell->sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+        dequeue_pos++;
+        return true;
+    }
+
+    /** Check whether there's anything to pop. Consumer thread only. */
+    bool empty() const {
+        return cells[dequeue_pos & mask].sequence.load(
+                   std::memory_order_acquire) != dequeue_pos + 1;
+    }
+};
+
+} // namespace redseen
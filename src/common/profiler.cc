@@ -0,0 +1,190 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "profiler.hh"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <stdexcept>
+
+namespace redseen {
+
+namespace {
+
+thread_local ProfileRing *thread_ring = nullptr;
+
+void write_json_string(std::ostream &out, const char *str) {
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    out << '"';
+    for (; *str != '\0'; str++) {
+        auto c = static_cast<unsigned char>(*str);
+        if (c == '"' || c == '\\')
+            out << '\\' << char(c);
+        else if (c < 0x20)
+            out << "\\u00" << HEX[c >> 4] << HEX[c & 0xf];
+        else
+            out << char(c);
+    }
+    out << '"';
+}
+
+/** Chrome traces count in microseconds */
+void write_micros(std::ostream &out, std::int64_t ns) {
+    if (ns < 0) {
+        out << '-';
+        ns = -ns;
+    }
+    auto frac = ns % 1000;
+    out << ns / 1000 << '.' << char('0' + frac / 100)
+        << char('0' + frac / 10 % 10) << char('0' + frac % 10);
+}
+
+} // namespace
+
+ProfileRing::ProfileRing(std::uint32_t thread_id, std::size_t capacity)
+    : records(std::make_unique<ProfileRecord[]>(std::bit_ceil(capacity))),
+      mask(std::bit_ceil(capacity) - 1), thread_id(thread_id) {}
+
+Profiler &Profiler::get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+ProfileRing &Profiler::get_thread_ring() {
+    if (thread_ring == nullptr) {
+        std::lock_guard lock(mutex);
+        rings.push_back(std::make_unique<ProfileRing>(
+            std::uint32_t(rings.size() + 1), ring_capacity));
+        thread_ring = rings.back().get();
+    }
+    return *thread_ring;
+}
+
+void Profiler::collect_locked() {
+    for (auto &ring : rings) {
+        ring->drain([this, &ring](const ProfileRecord &record) {
+            captured.push_back({record, ring->thread_id});
+        });
+    }
+}
+
+void Profiler::start_capture() {
+    std::lock_guard lock(mutex);
+    // whatever the rings hold is from before this capture
+    collect_locked();
+    captured.clear();
+    capturing.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::stop_capture() {
+    capturing.store(false, std::memory_order_relaxed);
+    collect();
+}
+
+void Profiler::set_ring_capacity(std::size_t capacity) {
+    std::lock_guard lock(mutex);
+    ring_capacity = std::max<std::size_t>(capacity, 2);
+}
+
+void Profiler::set_thread_name(std::string name) {
+    auto &ring = get_thread_ring();
+    std::lock_guard lock(mutex);
+    ring.thread_name = std::move(name);
+}
+
+void Profiler::zone(const char *name, std::int64_t start, std::int64_t end) {
+    get_thread_ring().push(
+        {name, ProfileRecord::Kind::ZONE, start, end - start});
+}
+
+void Profiler::counter(const char *name, std::int64_t value) {
+    get_thread_ring().push({name, ProfileRecord::Kind::COUNTER, now(), value});
+}
+
+void Profiler::collect() {
+    std::lock_guard lock(mutex);
+    collect_locked();
+}
+
+std::size_t Profiler::get_captured_count() const {
+    std::lock_guard lock(mutex);
+    return captured.size();
+}
+
+std::uint64_t Profiler::get_dropped_count() const {
+    std::lock_guard lock(mutex);
+    std::uint64_t n = 0;
+    for (const auto &ring : rings)
+        n += ring->get_dropped_count();
+    return n;
+}
+
+void Profiler::write_chrome_trace(std::ostream &out) const {
+    std::lock_guard lock(mutex);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto begin_event = [&out, &first] {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (const auto &ring : rings) {
+        if (ring->thread_name.empty())
+            continue;
+        begin_event();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << ring->thread_id << ",\"args\":{\"name\":";
+        write_json_string(out, ring->thread_name.c_str());
+        out << "}}";
+    }
+
+    for (const auto &[record, thread_id] : captured) {
+        begin_event();
+        out << "{\"name\":";
+        write_json_string(out, record.name);
+        out << ",\"ts\":";
+        write_micros(out, record.time);
+        if (record.kind == ProfileRecord::Kind::ZONE) {
+            out << ",\"ph\":\"X\",\"dur\":";
+            write_micros(out, record.value);
+        } else {
+            out << ",\"ph\":\"C\",\"args\":{\"value\":" << record.value
+                << '}';
+        }
+        out << ",\"pid\":1,\"tid\":" << thread_id << '}';
+    }
+
+    out << "\n]}\n";
+}
+
+void Profiler::save_chrome_trace(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("Profiler: can't open " + path);
+
+    write_chrome_trace(out);
+    if (!out.flush())
+        throw std::runtime_error("Profiler: can't write " + path);
+}
+
+} // namespace redseen
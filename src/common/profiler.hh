@@ -0,0 +1,213 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "common/noncopyable.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace redseen {
+
+/** A zone or counter sample taken by the profiler */
+struct ProfileRecord {
+    enum class Kind : std::uint8_t { ZONE, COUNTER };
+
+    /** Must outlive the capture, string literals are fine */
+    const char *name;
+    Kind kind;
+    /** Nanoseconds since the profiler was created */
+    std::int64_t time;
+    /** Duration in nanoseconds for zones, the value for counters */
+    std::int64_t value;
+};
+
+/** The records of a single thread.
+Only the owning thread pushes and only the collector pops, so both ends are
+a single atomic store. When the collector falls behind, new records are
+dropped and counted rather than blocking the thread. */
+class ProfileRing : NonCopyable {
+    std::unique_ptr<ProfileRecord[]> records;
+    std::size_t mask;
+
+    alignas(64) std::atomic<std::size_t> write_pos = 0;
+    alignas(64) std::atomic<std::size_t> read_pos = 0;
+    std::atomic<std::uint64_t> dropped = 0;
+
+  public:
+    const std::uint32_t thread_id;
+    /** Guarded by the profiler mutex */
+    std::string thread_name;
+
+    ProfileRing(std::uint32_t thread_id, std::size_t capacity);
+
+    /** Called by the owning thread only */
+    void push(const ProfileRecord &record) {
+        auto pos = write_pos.load(std::memory_order_relaxed);
+        if (pos - read_pos.load(std::memory_order_acquire) > mask) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        records[pos & mask] = record;
+        write_pos.store(pos + 1, std::memory_order_release);
+    }
+
+    /** Called by one collector at a time */
+    template <class F> std::size_t drain(F &&f) {
+        auto pos = read_pos.load(std::memory_order_relaxed);
+        auto end = write_pos.load(std::memory_order_acquire);
+        for (auto i = pos; i != end; i++)
+            f(records[i & mask]);
+        read_pos.store(end, std::memory_order_release);
+        return end - pos;
+    }
+
+    std::uint64_t get_dropped_count() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+};
+
+/** A low overhead CPU profiler of scoped zones and counters.
+Every thread records into its own ring, so recording never takes a lock.
+The rings have to be collected often enough not to overflow, the engine does
+it on every pass of its loop. Captures are exported as Chrome trace JSON, which
+chrome://tracing and Perfetto can open.
+Use the REDSEEN_PROFILE_* macros, they compile to nothing unless the engine
+is built with the REDSEEN_PROFILER option. */
+class Profiler : NonCopyable {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t DEFAULT_RING_CAPACITY = 1 << 15;
+
+    struct CapturedRecord {
+        ProfileRecord record;
+        std::uint32_t thread_id;
+    };
+
+  private:
+    const Clock::time_point epoch = Clock::now();
+    std::atomic<bool> capturing = false;
+    std::size_t ring_capacity = DEFAULT_RING_CAPACITY;
+
+    mutable std::mutex mutex;
+    /** Rings outlive their threads so whatever they recorded is kept */
+    std::vector<std::unique_ptr<ProfileRing>> rings;
+    std::vector<CapturedRecord> captured;
+
+    Profiler() = default;
+
+    ProfileRing &get_thread_ring();
+    void collect_locked();
+
+  public:
+    static Profiler &get();
+
+    /** Start recording, dropping the previous capture */
+    void start_capture();
+    /** Stop recording and collect what's left in the rings */
+    void stop_capture();
+    bool is_capturing() const {
+        return capturing.load(std::memory_order_relaxed);
+    }
+
+    /** Capacity of the rings created from now on, in records */
+    void set_ring_capacity(std::size_t capacity);
+
+    /** Name the calling thread in the exported traces */
+    void set_thread_name(std::string name);
+
+    /** Nanoseconds since the profiler was created */
+    std::int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   Clock::now() - epoch)
+            .count();
+    }
+
+    /** Record a zone on the calling thread */
+    void zone(const char *name, std::int64_t start, std::int64_t end);
+    /** Record a counter value on the calling thread */
+    void counter(const char *name, std::int64_t value);
+
+    /** Move the records of all threads into the capture */
+    void collect();
+
+    std::size_t get_captured_count() const;
+    /** Records dropped because a ring was full */
+    std::uint64_t get_dropped_count() const;
+
+    /** Write the capture as Chrome trace event JSON */
+    void write_chrome_trace(std::ostream &out) const;
+    /** Save the capture into a file, throws on I/O errors */
+    void save_chrome_trace(const std::string &path) const;
+};
+
+/** Records a zone spanning its lifetime */
+class ProfileZone : NonCopyable {
+    const char *name;
+    /** Negative if the profiler wasn't capturing when the zone was opened */
+    std::int64_t start = -1;
+
+  public:
+    explicit ProfileZone(const char *name) : name(name) {
+        auto &profiler = Profiler::get();
+        if (profiler.is_capturing())
+            start = profiler.now();
+    }
+
+    ~ProfileZone() {
+        if (start >= 0) {
+            auto &profiler = Profiler::get();
+            profiler.zone(name, start, profiler.now());
+        }
+    }
+};
+
+} // namespace redseen
+
+#define REDSEEN_PROFILE_CONCAT_(a, b) a##b
+#define REDSEEN_PROFILE_CONCAT(a, b) REDSEEN_PROFILE_CONCAT_(a, b)
+
+#ifdef REDSEEN_PROFILER
+/** Profile the rest of the enclosing scope */
+#define REDSEEN_PROFILE_ZONE(name)                                             \
+    ::redseen::ProfileZone REDSEEN_PROFILE_CONCAT(profile_zone_,               \
+                                                  __LINE__)(name)
+#define REDSEEN_PROFILE_COUNTER(name, value)                                   \
+    do {                                                                       \
+        auto &profiler_ = ::redseen::Profiler::get();                          \
+        if (profiler_.is_capturing())                                          \
+            profiler_.counter(name, std::int64_t(value));                      \
+    } while (0)
+#define REDSEEN_PROFILE_THREAD(name)                                           \
+    ::redseen::Profiler::get().set_thread_name(name)
+#else
+#define REDSEEN_PROFILE_ZONE(name) ((void)0)
+#define REDSEEN_PROFILE_COUNTER(name, value) ((void)0)
+#define REDSEEN_PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace redseen {
+
+/** A double ended queue stored in a single growable ring.
+Unlike std::deque it never gives memory back, so once it has grown to the
+steady state size pushing and popping doesn't touch the allocator. */
+template <class T> class RingDeque {
+    std::vector<T> storage;
+    std::size_t head = 0;
+    std::size_t count = 0;
+
+    std::size_t wrap(std::size_t i) const { return i & (storage.size() - 1); }
+
+    void grow() {
+        std::vector<T> new_storage(storage.empty() ? 16 : storage.size() * 2);
+        for (std::size_t i = 0; i < count; i++)
+            new_storage[i] = std::move(storage[wrap(head + i)]);
+        storage = std::move(new_storage);
+        head = 0;
+    }
+
+  public:
+    bool empty() const { return count == 0; }
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return storage.size(); }
+
+    T &front() { return storage[head]; }
+    const T &front() const { return storage[head]; }
+
+    T &back() { return storage[wrap(head + count - 1)]; }
+    const T &back() const { return storage[wrap(head + count - 1)]; }
+
+    T &operator[](std::size_t i) { return storage[wrap(head + i)]; }
+    const T &operator[](std::size_t i) const {
+        return storage[wrap(head + i)];
+    }
+
+    void push_back(T value) {
+        if (count == storage.size())
+            grow();
+        storage[wrap(head + count)] = std::move(value);
+        count++;
+    }
+
+    void push_front(T value) {
+        if (count == storage.size())
+            grow();
+        head = wrap(head + storage.size() - 1);
+        storage[head] = std::move(value);
+        count++;
+    }
+
+    void pop_front() {
+        storage[head] = T{};
+        head = wrap(head + 1);
+        count--;
+    }
+
+    void clear() {
+        while (!empty())
+            pop_front();
+        head = 0;
+    }
+};
+
+} // namespace redseen
@@ -0,0 +1,73 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "actor_thread.hh"
+
+namespace redseen::engine {
+
+ActorThread::ActorThread(std::size_t mailbox_capacity)
+    : mailbox(mailbox_capacity), thread([this] { run(); }) {}
+
+ActorThread::~ActorThread() {
+    stopping.store(true);
+    signal.fetch_add(1, std::memory_order_release);
+    signal.notify_one();
+    thread.join();
+}
+
+bool ActorThread::send(Forwarder &forwarder, std::uint32_t slot) {
+    if (!mailbox.try_push(Message{.forwarder = &forwarder, .slot = slot})) {
+        n_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    signal.fetch_add(1, std::memory_order_release);
+    signal.notify_one();
+    return true;
+}
+
+void ActorThread::run() {
+    Message message;
+
+    auto drain = [&] {
+        while (mailbox.try_pop(message)) {
+            message.forwarder->deliver(message.slot);
+        }
+    };
+
+    while (!stopping.load()) {
+        // read before checking the mailbox, so a send in between changes it
+        auto seen = signal.load(std::memory_order_acquire);
+        drain();
+        signal.wait(seen, std::memory_order_acquire);
+    }
+
+    // whatever was sent before stopping
+    drain();
+}
+
+std::size_t ActorThread::get_dropped_count() const {
+    return n_dropped.load(std::memory_order_relaxed);
+}
+
+bool ActorThread::is_current() const {
+    return std::this_thread::get_id() == thread.get_id();
+}
+
+} // namespace redseen::engine
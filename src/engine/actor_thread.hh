@@ -0,0 +1,189 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "common/mpsc_queue.hh"
+#include "common/noncopyable.hh"
+#include "event.hh"
+#include "event_dispatcher.hh"
+#include "event_observer.hh"
+
+namespace redseen::engine {
+
+/** A thread running observers off the dispatching thread.
+Observers registered through an ActorThread get copies of their events in
+slots pooled per observer, which the thread's mailbox refers to, and handle
+them there, after the dispatch. They can't
+drop events and must only reach the dispatcher through post(), which is also
+how replies get back to the main thread.
+The slot pools are single consumer: the events of an observer must all be
+dispatched from one thread, which is also the one registering observers. */
+class ActorThread : NonCopyable {
+    /** Registered in the dispatcher on behalf of an observer, forwards the
+     * events into the mailbox */
+    class Forwarder : public EventObserver {
+      protected:
+        ActorThread &actor;
+
+      public:
+        Forwarder(ActorThread &actor) : actor(actor) {}
+
+        /** Run the observer on the event in a slot, then free the slot.
+         * Called on the actor thread. */
+        virtual void deliver(std::uint32_t slot) = 0;
+        virtual bool is_expired() const = 0;
+        /** Take back the slots freed by the actor thread once expired.
+         * Returns true when all of them are back, so that no message refers
+         * to the forwarder anymore. Called on the dispatching thread. */
+        virtual bool reclaim_slots() = 0;
+    };
+
+    template <KeyedEvent T, class O> class TypedForwarder : public Forwarder {
+        std::weak_ptr<O> observer;
+        /** Copies of the events in the mailbox, as many as it can hold */
+        std::unique_ptr<std::optional<T>[]> slots;
+        /** Indices of the free slots, given back by the actor thread */
+        MpscQueue<std::uint32_t> free_slots;
+        /** Slots taken out of the pool for good by reclaim_slots() */
+        std::size_t n_reclaimed = 0;
+
+      public:
+        TypedForwarder(ActorThread &actor, const std::weak_ptr<O> &observer)
+            : Forwarder(actor), observer(observer),
+              slots(std::make_unique<std::optional<T>[]>(
+                  actor.mailbox.capacity())),
+              free_slots(actor.mailbox.capacity()) {
+            for (std::uint32_t i = 0; i < actor.mailbox.capacity(); i++)
+                free_slots.try_push(i);
+        }
+
+        ObserverReturnSignal on_event(const Event &ev) override {
+            // nobody to deliver to, the forwarder is about to be pruned
+            if (!ev.is_a<T>() || observer.expired()) [[unlikely]]
+                return ObserverReturnSignal::CONTINUE;
+
+            std::uint32_t slot;
+            if (!free_slots.try_pop(slot)) {
+                this->actor.n_dropped.fetch_add(1, std::memory_order_relaxed);
+                return ObserverReturnSignal::CONTINUE;
+            }
+
+            slots[slot].emplace(static_cast<const T &>(ev));
+            if (!this->actor.send(*this, slot)) {
+                slots[slot].reset();
+                free_slots.try_push(slot);
+            }
+            return ObserverReturnSignal::CONTINUE;
+        }
+
+        void deliver(std::uint32_t slot) override {
+            if (auto o = observer.lock())
+                o->on_event(*slots[slot]);
+            slots[slot].reset();
+            free_slots.try_push(slot);
+        }
+
+        bool is_expired() const override { return observer.expired(); }
+
+        bool reclaim_slots() override {
+            // an expired forwarder doesn't take slots anymore, so whatever
+            // gets popped stays out of the pool
+            std::uint32_t slot;
+            while (free_slots.try_pop(slot))
+                n_reclaimed++;
+            return n_reclaimed == this->actor.mailbox.capacity();
+        }
+    };
+
+    /** Forwarders stay owned by the actor for as long as messages may refer
+     * to them, see reclaim_slots() */
+    struct Message {
+        Forwarder *forwarder = nullptr;
+        /** Slot of the forwarder holding the event */
+        std::uint32_t slot = 0;
+    };
+
+    MpscQueue<Message> mailbox;
+    /** Bumped on every send, the thread sleeps on it */
+    std::atomic<std::uint32_t> signal = 0;
+    std::atomic<bool> stopping = false;
+    /** Bumped by the dispatching threads, read from any */
+    std::atomic<std::size_t> n_dropped = 0;
+
+    /** Owned here, the dispatcher only holds weak references */
+    std::vector<std::shared_ptr<Forwarder>> forwarders;
+
+    std::thread thread;
+
+    void run();
+    /** Queue the event in a slot of a forwarder. Returns false if the
+     * mailbox is full. */
+    bool send(Forwarder &forwarder, std::uint32_t slot);
+
+  public:
+    static constexpr std::size_t DEFAULT_MAILBOX_CAPACITY = 1024;
+
+    explicit ActorThread(std::size_t mailbox_capacity = DEFAULT_MAILBOX_CAPACITY);
+    /** Handles the messages already sent, then joins the thread */
+    ~ActorThread();
+
+    /** Register an observer of T in the dispatcher, running on this thread.
+    The observer needs an on_event(const T &) member, like for the typed
+    EventDispatcher::register_observer. Events are copied into slots
+    allocated with the observer, so T must be copy constructible. */
+    template <KeyedEvent T, class O>
+        requires std::copy_constructible<T>
+    ObserverHandle register_observer(EventDispatcher &disp,
+                                     const std::string_view &observer_name,
+                                     std::size_t priority_class,
+                                     std::size_t priority,
+                                     const std::weak_ptr<O> &observer) {
+        std::erase_if(forwarders, [](const auto &forwarder) {
+            return forwarder->is_expired() && forwarder->reclaim_slots();
+        });
+
+        auto forwarder = std::make_shared<TypedForwarder<T, O>>(*this, observer);
+        auto handle =
+            disp.register_observer(observer_name, T::event_key(),
+                                   priority_class, priority,
+                                   std::weak_ptr<EventObserver>(forwarder));
+        forwarders.push_back(std::move(forwarder));
+        return handle;
+    }
+
+    /** Number of events lost to a full mailbox */
+    std::size_t get_dropped_count() const;
+
+    /** Check whether the calling thread is this one */
+    bool is_current() const;
+};
+
+} // namespace redseen::engine
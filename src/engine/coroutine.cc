@@ -0,0 +1,193 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "coroutine.hh"
+
+#include <algorithm>
+
+namespace redseen::engine {
+
+void EventAwaiter::await_suspend(Task::Handle handle) {
+    waiter.handle = handle;
+    handle.promise().scheduler->wait_for(event_id, waiter);
+}
+
+void DelayAwaiter::await_suspend(Task::Handle handle) {
+    waiter.handle = handle;
+    handle.promise().scheduler->wait_ticks(n_ticks, waiter);
+}
+
+CoroutineScheduler::CoroutineScheduler(const EventKey &tick_key,
+                                       std::size_t priority_class,
+                                       std::size_t priority)
+    : tick_key(tick_key), priority_class(priority_class),
+      priority(priority) {}
+
+std::shared_ptr<CoroutineScheduler>
+CoroutineScheduler::create(const EventKey &tick_key,
+                           std::size_t priority_class, std::size_t priority) {
+    struct SharedHelper : public CoroutineScheduler {
+        SharedHelper(const EventKey &tick_key, std::size_t priority_class,
+                     std::size_t priority)
+            : CoroutineScheduler(tick_key, priority_class, priority) {}
+    };
+    return std::make_shared<SharedHelper>(tick_key, priority_class, priority);
+}
+
+CoroutineScheduler::~CoroutineScheduler() {
+    for (auto handle : tasks)
+        handle.destroy();
+}
+
+void CoroutineScheduler::attach(EventDispatcher &disp) {
+    dispatchers.push_back(&disp);
+    disp.register_observer(OBSERVER_NAME, tick_key, priority_class, priority,
+                           weak_from_this());
+    for (EventId id = 0; id < wait_lists.size(); id++) {
+        if (wait_lists[id].registered && id != tick_key.get_id())
+            disp.register_observer(OBSERVER_NAME,
+                                   EventKey(EventRegistry::instance().name(id)),
+                                   priority_class, priority, weak_from_this());
+    }
+}
+
+void CoroutineScheduler::register_key(EventId event_id) {
+    if (event_id >= wait_lists.size())
+        wait_lists.resize(event_id + 1);
+
+    auto &list = wait_lists[event_id];
+    if (list.registered)
+        return;
+    list.registered = true;
+
+    // The tick key is observed since attaching
+    if (event_id == tick_key.get_id())
+        return;
+
+    EventKey key(EventRegistry::instance().name(event_id));
+    for (auto *disp : dispatchers)
+        disp->register_observer(OBSERVER_NAME, key, priority_class, priority,
+                                weak_from_this());
+}
+
+void CoroutineScheduler::push_waiter(WaitList &list, EventWaiter &waiter) {
+    waiter.next = nullptr;
+    if (list.tail)
+        list.tail->next = &waiter;
+    else
+        list.head = &waiter;
+    list.tail = &waiter;
+}
+
+void CoroutineScheduler::wait_for(EventId event_id, EventWaiter &waiter) {
+    register_key(event_id);
+    push_waiter(wait_lists[event_id], waiter);
+}
+
+void CoroutineScheduler::wait_ticks(std::uint64_t n_ticks,
+                                    EventWaiter &waiter) {
+    // the current tick has already been handled
+    waiter.resume_tick = tick_count + std::max<std::uint64_t>(n_ticks, 1);
+    push_waiter(delay_lists[waiter.resume_tick], waiter);
+}
+
+void CoroutineScheduler::resume(Task::Handle handle) {
+    handle.resume();
+    if (!handle.done())
+        return;
+
+    n_finished++;
+    if (handle.promise().exception && !pending_exception)
+        pending_exception = handle.promise().exception;
+}
+
+void CoroutineScheduler::collect_finished() {
+    if (n_finished == 0)
+        return;
+
+    std::erase_if(tasks, [](Task::Handle handle) {
+        if (!handle.done())
+            return false;
+        handle.destroy();
+        return true;
+    });
+    n_finished = 0;
+}
+
+void CoroutineScheduler::spawn(Task task) {
+    auto handle = task.release();
+    handle.promise().scheduler = this;
+    tasks.push_back(handle);
+
+    resume(handle);
+    collect_finished();
+
+    if (pending_exception)
+        std::rethrow_exception(std::exchange(pending_exception, nullptr));
+}
+
+std::size_t CoroutineScheduler::get_task_count() const {
+    return tasks.size() - n_finished;
+}
+
+ObserverReturnSignal CoroutineScheduler::on_event(const Event &ev) {
+    // Lists are detached before resuming, so that tasks awaiting again wait
+    // for the next event instead of this one. That includes a task woken
+    // from a delay by this tick, then waiting for the tick key.
+    EventWaiter *waiter = nullptr;
+    if (ev.id < wait_lists.size()) {
+        waiter = std::exchange(wait_lists[ev.id].head, nullptr);
+        wait_lists[ev.id].tail = nullptr;
+    }
+
+    if (ev.id == tick_key.get_id()) {
+        tick_count++;
+
+        // the ticks come one by one, so each list is reached at its tick
+        if (auto node = delay_lists.extract(tick_count)) {
+            auto *delayed = node.mapped().head;
+            while (delayed) {
+                auto *next = delayed->next;
+                resume(delayed->handle);
+                delayed = next;
+            }
+        }
+    }
+
+    // the resumed tasks may have registered keys, which moves the lists
+    while (waiter) {
+        auto *next = waiter->next;
+        if (waiter->accepts == nullptr || waiter->accepts(ev)) {
+            waiter->event = &ev;
+            resume(waiter->handle);
+        } else {
+            push_waiter(wait_lists[ev.id], *waiter);
+        }
+        waiter = next;
+    }
+
+    collect_finished();
+
+    if (pending_exception)
+        std::rethrow_exception(std::exchange(pending_exception, nullptr));
+
+    return ObserverReturnSignal::CONTINUE;
+}
+
+} // namespace redseen::engine
@@ -0,0 +1,221 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/noncopyable.hh"
+#include "event.hh"
+#include "event_dispatcher.hh"
+#include "event_key.hh"
+#include "event_observer.hh"
+
+namespace redseen::engine {
+
+class CoroutineScheduler;
+
+/** A coroutine driven by events. It doesn't run until it's handed to
+CoroutineScheduler::spawn, which owns it from then on.
+Inside, next_event() and delay() can be awaited. */
+class Task {
+  public:
+    struct promise_type {
+        CoroutineScheduler *scheduler = nullptr;
+        std::exception_ptr exception;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        /** Kept until the scheduler gets back control, then rethrown */
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task(Task &&oth) noexcept : handle(std::exchange(oth.handle, nullptr)) {}
+    Task &operator=(Task &&oth) noexcept {
+        if (this != &oth) {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(oth.handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle)
+            handle.destroy();
+    }
+
+    /** Give up the ownership of the coroutine */
+    Handle release() { return std::exchange(handle, nullptr); }
+
+  private:
+    explicit Task(Handle handle) : handle(handle) {}
+
+    Handle handle;
+};
+
+/** A suspended coroutine linked into a wait list of the scheduler. It lives
+ * in the coroutine frame, inside the awaiter. */
+struct EventWaiter {
+    EventWaiter *next = nullptr;
+    Task::Handle handle;
+    /** The event which resumed the coroutine */
+    const Event *event = nullptr;
+    /** Tick count to resume at, for delays */
+    std::uint64_t resume_tick = 0;
+    /** Filter of the events resuming the coroutine, nullptr takes any event
+     * of the key */
+    bool (*accepts)(const Event &) = nullptr;
+};
+
+/** Awaiter of the next event of a key. Resumes with the event, which is
+ * only valid until the coroutine suspends again. */
+class EventAwaiter {
+  protected:
+    EventId event_id;
+    EventWaiter waiter;
+
+  public:
+    explicit EventAwaiter(EventId event_id) : event_id(event_id) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(Task::Handle handle);
+    const Event &await_resume() const { return *waiter.event; }
+};
+
+template <KeyedEvent T> class TypedEventAwaiter : public EventAwaiter {
+  public:
+    TypedEventAwaiter() : EventAwaiter(T::event_key().get_id()) {
+        // events of the key which aren't a T don't count
+        waiter.accepts = [](const Event &ev) { return ev.is_a<T>(); };
+    }
+
+    const T &await_resume() const {
+        return static_cast<const T &>(*waiter.event);
+    }
+};
+
+/** Awaiter of a number of ticks */
+class DelayAwaiter {
+    std::uint64_t n_ticks;
+    EventWaiter waiter;
+
+  public:
+    explicit DelayAwaiter(std::uint64_t n_ticks) : n_ticks(n_ticks) {}
+
+    bool await_ready() const noexcept { return n_ticks == 0; }
+    void await_suspend(Task::Handle handle);
+    void await_resume() const {}
+};
+
+/** co_await the next event of a key */
+inline EventAwaiter next_event(const EventKey &key) {
+    return EventAwaiter(key.get_id());
+}
+
+/** co_await the next event of a type, getting it as that type */
+template <KeyedEvent T> TypedEventAwaiter<T> next_event() {
+    return TypedEventAwaiter<T>();
+}
+
+/** co_await a number of ticks of the scheduler */
+inline DelayAwaiter delay(std::uint64_t n_ticks) {
+    return DelayAwaiter(n_ticks);
+}
+
+/** Runs Tasks, resuming them with the events they wait for.
+The scheduler observes the dispatchers attached to it, registering for a key
+the first time a task waits for it. Suspended tasks are kept in intrusive
+lists by EventId, so an event costs only as much as the tasks waiting for
+it. Delays count the events of a tick key, the delayed tasks are kept by the
+tick they resume at, so a tick only costs as much as the tasks it resumes. */
+class CoroutineScheduler : public EventObserver,
+                           NonCopyable,
+                           public std::enable_shared_from_this<CoroutineScheduler> {
+    struct WaitList {
+        EventWaiter *head = nullptr;
+        EventWaiter *tail = nullptr;
+        bool registered = false;
+    };
+
+    EventKey tick_key;
+    std::size_t priority_class;
+    std::size_t priority;
+    std::vector<EventDispatcher *> dispatchers;
+
+    std::vector<WaitList> wait_lists;
+    /** Tasks waiting for a number of ticks, by the tick count to resume at */
+    std::unordered_map<std::uint64_t, WaitList> delay_lists;
+    std::uint64_t tick_count = 0;
+
+    std::vector<Task::Handle> tasks;
+    std::size_t n_finished = 0;
+    /** First exception thrown by a task during the current event */
+    std::exception_ptr pending_exception;
+
+    CoroutineScheduler(const EventKey &tick_key, std::size_t priority_class,
+                       std::size_t priority);
+
+    void register_key(EventId event_id);
+    static void push_waiter(WaitList &list, EventWaiter &waiter);
+    void resume(Task::Handle handle);
+    void collect_finished();
+
+  public:
+    static constexpr std::string_view OBSERVER_NAME = "engine.coroutines";
+
+    static std::shared_ptr<CoroutineScheduler>
+    create(const EventKey &tick_key, std::size_t priority_class = 0,
+           std::size_t priority = 0);
+
+    ~CoroutineScheduler();
+
+    /** Observe a dispatcher for the events tasks wait for */
+    void attach(EventDispatcher &disp);
+
+    /** Start a task. It runs until its first suspension right away.
+    Exceptions escaping tasks are rethrown by spawn or on_event. */
+    void spawn(Task task);
+
+    /** Number of tasks which haven't finished yet */
+    std::size_t get_task_count() const;
+
+    /** Suspend a task until the next event of an id. Used by awaiters. */
+    void wait_for(EventId event_id, EventWaiter &waiter);
+
+    /** Suspend a task for a number of ticks. Used by awaiters. */
+    void wait_ticks(std::uint64_t n_ticks, EventWaiter &waiter);
+
+    ObserverReturnSignal on_event(const Event &ev) override;
+};
+
+} // namespace redseen::engine
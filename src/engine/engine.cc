@@ -19,12 +19,16 @@
 
 #include "engine.hh"
 
+#include <algorithm>
 #include <chrono>
+#include <stdexcept>
 #include <thread>
+#include <utility>
 #include <memory>
 #include <glad/glad.h>
 
 #include "camera.hh"
+#include "common/profiler.hh"
 #include "engine/event_dispatcher.hh"
 #include "engine/event_observer.hh"
 #include "engine/event_producer_container.hh"
@@ -61,8 +65,8 @@ void Engine::FrameState::Start::take_event(const Event &ev) {
     if (!ev.has_name(engine_events::TICK))
         return;
 
-    engine.get_internal_event_dispatcher()->queue_next(
-        std::make_shared<Event>(engine_events::UPDATE));
+    engine.get_internal_event_dispatcher()->emplace_next<Event>(
+        engine_events::UPDATE);
 
     engine.frame_state = std::unique_ptr<FrameState>(
         new Engine::FrameState::WaitingForUpdate(engine));
@@ -77,8 +81,8 @@ void Engine::FrameState::WaitingForUpdate::take_event(const Event &ev) {
         return;
 
     if (object_update_done && render_update_done) {
-        engine.get_internal_event_dispatcher()->queue_next(
-            std::make_shared<Event>(engine_events::RENDER));
+        engine.get_internal_event_dispatcher()->emplace_next<Event>(
+            engine_events::RENDER);
         engine.frame_state = std::unique_ptr<FrameState>(
             new Engine::FrameState::WaitingForRender(engine));
     }
@@ -88,8 +92,8 @@ void Engine::FrameState::WaitingForRender::take_event(const Event &ev) {
     if (!ev.has_name(engine_events::RENDER_DONE))
         return;
 
-    engine.get_internal_event_dispatcher()->queue_next(
-        std::make_shared<Event>(engine_events::PRESENT));
+    engine.get_internal_event_dispatcher()->emplace_next<Event>(
+        engine_events::PRESENT);
 
     engine.frame_state =
         std::unique_ptr<FrameState>(new Engine::FrameState::Start(engine));
@@ -132,6 +136,140 @@ void Engine::set_renderer(const std::shared_ptr<Renderer> &renderer) {
     this->renderer = renderer;
 }
 
+const std::shared_ptr<TimerWheel> &Engine::get_timer_wheel() const {
+    return timer_wheel;
+}
+
+const std::shared_ptr<JobSystem> &Engine::get_job_system() const {
+    return job_system;
+}
+
+const std::shared_ptr<CoroutineScheduler> &
+Engine::get_coroutine_scheduler() const {
+    return coroutine_scheduler;
+}
+
+void Engine::set_tick_delay(std::chrono::nanoseconds delay) {
+    if (delay <= std::chrono::nanoseconds::zero())
+        throw std::invalid_argument("Tick delay must be positive");
+    tick_delay = delay;
+}
+
+std::chrono::nanoseconds Engine::get_tick_delay() const { return tick_delay; }
+
+void Engine::set_frame_delay(std::chrono::nanoseconds delay) {
+    frame_pacer.set_target_interval(delay);
+}
+
+std::chrono::nanoseconds Engine::get_frame_delay() const {
+    return frame_pacer.get_target_interval();
+}
+
+void Engine::set_frame_rate(double frames_per_second) {
+    frame_pacer.set_target_rate(frames_per_second);
+}
+
+void Engine::set_swap_interval(int interval) {
+    swap_interval = std::max(interval, 0);
+    if (renderer != nullptr)
+        apply_swap_interval();
+}
+
+int Engine::get_swap_interval() const { return swap_interval; }
+
+void Engine::apply_swap_interval() {
+    renderer->set_swap_interval(swap_interval);
+    frame_pacer.set_vsync_interval(
+        swap_interval != 0 ? renderer->get_refresh_interval() * swap_interval
+                           : std::chrono::nanoseconds::zero());
+}
+
+FramePacer &Engine::get_frame_pacer() { return frame_pacer; }
+
+const FramePacer &Engine::get_frame_pacer() const { return frame_pacer; }
+
+float Engine::get_interpolation_alpha() const { return interpolation_alpha; }
+
+void Engine::set_pipelined_frames(bool enabled) {
+    if (pipelined_frames && !enabled)
+        simulate_pending_ticks();
+    pipelined_frames = enabled;
+}
+
+bool Engine::is_pipelined_frames() const { return pipelined_frames; }
+
+void Engine::set_external_event_budget(std::chrono::nanoseconds budget) {
+    external_event_budget = budget;
+}
+
+std::chrono::nanoseconds Engine::get_external_event_budget() const {
+    return external_event_budget;
+}
+
+void Engine::record_events(std::shared_ptr<EventRecorder> recorder) {
+    if (event_recorder != nullptr) {
+        event_recorder->detach(*event_dispatcher);
+        event_recorder->detach(*internal_event_dispatcher);
+    }
+
+    event_recorder = std::move(recorder);
+    if (event_recorder != nullptr) {
+        // the ticks left from pipelined frames go before the recorded ones
+        simulate_pending_ticks();
+
+        // the external events are flushed at the start of each tick, the
+        // internal ones are dispatched in order with the queued TICKs
+        const auto first_tick = tick_count;
+        event_recorder->attach(
+            *event_dispatcher, std::uint8_t(EventChannel::EXTERNAL),
+            [this, first_tick] { return tick_count - first_tick; });
+        event_recorder->attach(
+            *internal_event_dispatcher, std::uint8_t(EventChannel::INTERNAL),
+            [this, first_tick] { return n_queued_ticks - first_tick; });
+    }
+}
+
+void Engine::replay_events(std::shared_ptr<const EventRecording> recording) {
+    external_replayer = std::make_unique<EventReplayer>(
+        recording, std::uint8_t(EventChannel::EXTERNAL));
+    internal_replayer = std::make_unique<EventReplayer>(
+        recording, std::uint8_t(EventChannel::INTERNAL));
+    simulate_pending_ticks();
+    replay_first_tick = tick_count;
+
+    if (muted_event_dispatcher == nullptr)
+        muted_event_dispatcher = std::make_unique<EventDispatcher>();
+    event_dispatcher->set_ingress_muted(true);
+    internal_event_dispatcher->set_ingress_muted(true);
+
+    // the input recorded before the first tick
+    feed_replayed_events();
+}
+
+bool Engine::is_replaying() const { return internal_replayer != nullptr; }
+
+bool Engine::is_reproducible() const {
+    return event_recorder != nullptr || is_replaying();
+}
+
+void Engine::feed_replayed_events() {
+    const auto tick = tick_count - replay_first_tick;
+    internal_replayer->set_tick(tick);
+    internal_replayer->feed_dispatcher(*internal_event_dispatcher, false);
+    external_replayer->set_tick(tick);
+    external_replayer->feed_dispatcher(*event_dispatcher, false);
+}
+
+void Engine::stop_replay() {
+    external_replayer.reset();
+    internal_replayer.reset();
+    event_dispatcher->set_ingress_muted(false);
+    internal_event_dispatcher->set_ingress_muted(false);
+    // don't make up for the ticks missed while replaying
+    tick_start_time = std::chrono::steady_clock::now();
+    frame_pacer.reset(tick_start_time);
+}
+
 Camera &Engine::get_player_camera() { return player_camera; }
 
 const Camera &Engine::get_player_camera() const { return player_camera; }
@@ -146,33 +284,90 @@ void Engine::init_opengl() {
 void Engine::init() {
     event_dispatcher = std::make_unique<EventDispatcher>();
     internal_event_dispatcher = std::make_unique<EventDispatcher>();
+    event_dispatcher->set_waker(internal_event_dispatcher->get_waker());
+    // input must not wait behind bulk events nor for the next frame
+    auto input_lane = event_dispatcher->add_lane(
+        "input", INPUT_LANE_PRIORITY, INPUT_LANE_WEIGHT, true);
+    event_dispatcher->set_event_lane("window.*", input_lane);
     event_producers = std::make_unique<EventProducerContainer>();
     internal_event_producers = std::make_unique<EventProducerContainer>();
     object_manager = std::make_shared<ObjectManager>(shared_from_this());
     texture_manager = std::make_shared<TextureManager>();
+    // advanced by the ticks instead of fed as a producer
+    timer_wheel = std::make_shared<TimerWheel>();
+
+    job_system = std::make_shared<JobSystem>();
+    event_dispatcher->set_observer_executor(job_system);
+    internal_event_dispatcher->set_observer_executor(job_system);
+
+    coroutine_scheduler = CoroutineScheduler::create(
+        engine_events::TICK, 0, std::size_t(PipelinePriority::OBJECT_MANAGER));
+    coroutine_scheduler->attach(*internal_event_dispatcher);
+    coroutine_scheduler->attach(*event_dispatcher);
 }
 
 bool Engine::run() {
-    bool ret;
+    run_for(NO_TICK_LIMIT);
+    return true;
+}
 
-    get_renderer()->init();
+std::uint64_t Engine::run_for(std::uint64_t n_ticks) {
+    start();
+
+    const auto first_tick = tick_count;
+    tick_limit = n_ticks >= NO_TICK_LIMIT - tick_count ? NO_TICK_LIMIT
+                                                        : tick_count + n_ticks;
+    // ticks missed between the runs aren't made up for, but the ones a
+    // stopped run left queued are still dispatched and count towards the
+    // limit through n_queued_ticks
+    tick_start_time = std::chrono::steady_clock::now();
+    frame_pacer.reset(tick_start_time);
+
+    internal_dispatch_loop();
+
+    // leave the objects idle and up to date
+    simulate_pending_ticks();
+    stop_requested = false;
+    return tick_count - first_tick;
+}
+
+void Engine::start() {
+    if (started)
+        return;
+    started = true;
+
+    REDSEEN_PROFILE_THREAD("main");
+
+    if (!is_headless()) {
+        get_renderer()->init();
+        apply_swap_interval();
+        get_renderer()->subscribe_dispatcher(get_renderer(),
+                                             *internal_event_dispatcher);
+    }
     reset_frame_state();
 
     subscribe_dispatcher(*internal_event_dispatcher);
-    get_renderer()->subscribe_dispatcher(get_renderer(),
-                                         *internal_event_dispatcher);
 
     get_object_manager()->subscribe_dispatcher(get_object_manager(),
                                                *internal_event_dispatcher);
 
     internal_event_producers->add_producer("engine", shared_from_this());
+}
 
-    tick_start_time = std::chrono::steady_clock::now();
-
-    internal_dispatch_loop();
-    return true;
+void Engine::stop() {
+    stop_requested = true;
+    // the waker is shared by both dispatchers and ends any wait of the loop
+    internal_event_dispatcher->get_waker()->notify();
 }
 
+bool Engine::is_headless() const { return renderer == nullptr; }
+
+void Engine::set_unthrottled(bool enabled) { unthrottled = enabled; }
+
+bool Engine::is_unthrottled() const { return unthrottled; }
+
+std::uint64_t Engine::get_tick_count() const { return tick_count; }
+
 std::shared_ptr<Engine> Engine::create() {
     struct SharedHelper : public Engine {};
     std::shared_ptr<Engine> engine_ = std::make_shared<SharedHelper>();
@@ -189,23 +384,110 @@ ObserverReturnSignal Engine::on_event(const Event &ev) {
     frame_state->take_event(ev);
 #endif
 
-    if (!ev.has_name(engine_events::TICK))
-        return ObserverReturnSignal::CONTINUE;
+    if (ev.has_name(engine_events::TICK))
+        simulate_tick();
+    else if (ev.has_name(engine_events::RENDER))
+        render_frame();
 
-    handle_frame();
     return ObserverReturnSignal::CONTINUE;
 }
 
-void Engine::handle_frame() {
+void Engine::simulate_tick() {
 #ifdef DEBUG
-    std::cerr << "---- Engine::handle_frame(): called ---" << std::endl;
+    std::cerr << "---- Engine::simulate_tick(): called ---" << std::endl;
 #endif
+    REDSEEN_PROFILE_ZONE("Engine::simulate_tick");
+
+    // the input queued before the tick is handled right before it
+    if (is_reproducible())
+        event_dispatcher->dispatch();
+
+    tick_count++;
+
+    // without frames there's nothing to overlap the simulation with, and
+    // a reproducible run updates the objects in order with the input
+    if (pipelined_frames && !is_headless() && !is_reproducible())
+        n_pending_ticks++;
+    else
+        object_manager->update();
+
+    // the timers due by the end of the tick are handled before the next one
+    timer_wheel->advance_time(*event_dispatcher, tick_delay);
+
+    if (is_replaying())
+        feed_replayed_events();
+}
+
+void Engine::render_frame() {
+#ifdef DEBUG
+    std::cerr << "---- Engine::render_frame(): called ---" << std::endl;
+#endif
+    REDSEEN_PROFILE_ZONE("Engine::render_frame");
+
+    frame_queued = false;
+    frame_pacer.wait_for_frame();
+
+    // the pending ticks haven't reached the objects yet, so the state they
+    // show is that many ticks older
+    auto since_tick = std::chrono::steady_clock::now() - tick_start_time;
+    interpolation_alpha = std::clamp(
+        std::chrono::duration<float>(since_tick) /
+                std::chrono::duration<float>(tick_delay) +
+            float(n_pending_ticks),
+        0.f, 1.f);
+
+    // GL work queued by the jobs
+    job_system->run_main_thread_jobs();
+
+    if (pipelined_frames) {
+        render_pipelined_frame();
+        return;
+    }
 
-    object_manager->update();
     renderer->update();
     handle_external_events();
     renderer->render();
     renderer->present();
+    frame_pacer.frame_presented();
+}
+
+void Engine::render_pipelined_frame() {
+    // the objects are idle until the simulation starts
+    render_state.clear();
+    render_state.interpolation_alpha = interpolation_alpha;
+    object_manager->extract(render_state);
+
+    if (auto n_ticks = std::exchange(n_pending_ticks, 0); n_ticks != 0) {
+        simulation = job_system->submit([this, n_ticks] {
+            REDSEEN_PROFILE_ZONE("Engine::simulation");
+            for (std::size_t i = 0; i < n_ticks; i++)
+                object_manager->update();
+        });
+    }
+
+    renderer->update();
+    renderer->render(render_state);
+    renderer->present();
+    frame_pacer.frame_presented();
+
+    // the observers may touch the objects, so nothing is dispatched while
+    // they're updated
+    finish_simulation();
+    handle_external_events();
+}
+
+void Engine::simulate_pending_ticks() {
+    finish_simulation();
+    for (; n_pending_ticks != 0; n_pending_ticks--)
+        object_manager->update();
+}
+
+void Engine::finish_simulation() {
+    // rethrows what the updates have thrown
+    if (auto job = std::exchange(simulation, nullptr)) {
+        REDSEEN_PROFILE_ZONE("Engine::finish_simulation");
+        job_system->wait(job);
+    }
 }
 
 static bool is_engine_event(const Event &ev) {
@@ -213,11 +495,11 @@ static bool is_engine_event(const Event &ev) {
 }
 
 void Engine::subscribe_dispatcher(EventDispatcher &disp) {
-    internal_event_dispatcher->register_observer(
+    disp.register_observer(
         "engine.engine",
         {engine_events::TICK, engine_events::OBJECT_UPDATE_DONE,
          engine_events::RENDER_UPDATE_DONE, engine_events::RENDER_DONE,
-         engine_events::UPDATE},
+         engine_events::UPDATE, engine_events::RENDER},
         0, std::size_t(PipelinePriority::ENGINE), weak_from_this());
 }
 
@@ -228,51 +510,154 @@ void Engine::reset_frame_state() {
 }
 
 void Engine::internal_dispatch_loop() {
-    while (1) {
-        internal_event_producers->feed_dispatcher(*internal_event_dispatcher,
-                                                  true);
+    while (!stop_requested && tick_count < tick_limit) {
+        receive_internal_events();
+
+        // replays run as fast as they can
+        if (!is_replaying() && !unthrottled &&
+            !internal_event_dispatcher->has_events())
+            wait_for_events();
 
         internal_event_dispatcher->dispatch();
+
+        // there are no frames to handle them
+        if (is_headless())
+            handle_external_events();
+
+#ifdef REDSEEN_PROFILER
+        // keep the rings from overflowing
+        if (Profiler::get().is_capturing())
+            Profiler::get().collect();
+#endif
+    }
+}
+
+void Engine::wait_for_events() {
+    auto deadline = std::min(internal_event_producers->next_deadline(),
+                             event_producers->next_deadline());
+
+    // both dispatchers share a waker, so a post to either one ends the wait
+    event_producers->wait_until(*event_dispatcher, deadline);
+
+    // don't let input which has just arrived wait for the next frame
+    handle_external_events();
+}
+
+void Engine::receive_internal_events() {
+    if (internal_replayer == nullptr) {
+        internal_event_producers->feed_dispatcher(*internal_event_dispatcher,
+                                                  false);
+        return;
     }
+
+    if (internal_replayer->is_finished() && external_replayer->is_finished()) {
+        stop_replay();
+        internal_event_producers->feed_dispatcher(*internal_event_dispatcher,
+                                                  false);
+        return;
+    }
+
+    // the ticks still come from the engine, the input is replayed after
+    // each one
+    internal_event_producers->feed_dispatcher(
+        *internal_event_dispatcher, *muted_event_dispatcher, false);
+    muted_event_dispatcher->drop_queue();
 }
 
 void Engine::receive_external_events() {
-    event_producers->feed_dispatcher(*event_dispatcher, false);
+    if (external_replayer == nullptr) {
+        event_producers->feed_dispatcher(*event_dispatcher, false);
+        return;
+    }
+
+    // keep polling the producers so the window stays responsive
+    event_producers->feed_dispatcher(*event_dispatcher,
+                                     *muted_event_dispatcher, false);
+    muted_event_dispatcher->drop_queue();
 }
 
-void Engine::dispatch_external_events() { event_dispatcher->dispatch(); }
+void Engine::dispatch_external_events() {
+    // a reproducible run dispatches them at the start of the ticks only, so
+    // they can't interleave with the internal events by timing
+    if (is_reproducible())
+        return;
+
+    event_dispatcher->dispatch_for(external_event_budget);
+}
 
 void Engine::handle_external_events() {
     receive_external_events();
     dispatch_external_events();
 }
 
-/** Feeds engine with TICK each 16ms (todo: make it configurable, dependent on
- * vsync etc) */
+/** Feeds engine with a TICK every tick_delay and a RENDER every frame of the
+ * pacer */
 std::size_t Engine::feed_dispatcher(EventDispatcher &disp, bool can_block) {
-    constexpr auto TICK_DELAY = std::chrono::milliseconds(16);
-    constexpr std::size_t MAX_CONSECUTIVE_TICKS = 32;
-
-    auto cur_time = std::chrono::steady_clock::now();
-    auto time_delta = cur_time - tick_start_time;
-
-    if (time_delta >= TICK_DELAY) {
-        std::size_t n_ticks = std::min(std::size_t(time_delta / TICK_DELAY),
-                                       MAX_CONSECUTIVE_TICKS);
-        auto event = std::make_shared<Event>(engine_events::TICK);
-        for (auto i = 0; i < n_ticks; i++)
-            disp.queue_last(event);
-
-        tick_start_time = cur_time;
-        return n_ticks;
-    } else if (can_block) {
-        std::this_thread::sleep_for(TICK_DELAY - time_delta);
-        disp.queue_last(std::make_shared<Event>(engine_events::TICK));
-        tick_start_time += TICK_DELAY;
-        return 1;
-    } else {
+    auto now = std::chrono::steady_clock::now();
+
+    if (can_block && now < next_deadline()) {
+        // sleep until the next tick or frame unless some thread posts an
+        // event earlier
+        if (disp.wait_for_events(next_deadline()))
+            return 0;
+        now = std::chrono::steady_clock::now();
+    }
+
+    // the ticks go first, so that the frame shows their result
+    auto n_events = queue_ticks(disp, now);
+    return n_events + queue_frame(disp, now);
+}
+
+std::size_t Engine::queue_ticks(EventDispatcher &disp,
+                                std::chrono::steady_clock::time_point now) {
+    auto n_ticks = std::size_t((now - tick_start_time) / tick_delay);
+
+    if (unthrottled || is_replaying()) {
+        // a tick each pass of the loop
+        n_ticks = 1;
+        tick_start_time = now;
+    } else if (n_ticks == 0) {
         return 0;
+    } else if (n_ticks > MAX_CONSECUTIVE_TICKS) {
+        // too far behind to catch up, the simulation slows down instead
+        n_ticks = MAX_CONSECUTIVE_TICKS;
+        tick_start_time = now;
+    } else {
+        // the remainder is kept so the step stays fixed
+        tick_start_time += n_ticks * tick_delay;
     }
+
+    // the run stops at its tick limit, which the ticks left queued by the
+    // previous run may have reached already
+    n_ticks = n_queued_ticks >= tick_limit
+                  ? 0
+                  : std::min<std::uint64_t>(n_ticks,
+                                            tick_limit - n_queued_ticks);
+    n_queued_ticks += n_ticks;
+
+    for (std::size_t i = 0; i < n_ticks; i++)
+        disp.emplace_last<Event>(engine_events::TICK);
+    return n_ticks;
+}
+
+std::size_t Engine::queue_frame(EventDispatcher &disp,
+                                std::chrono::steady_clock::time_point now) {
+    if (is_headless() || frame_queued || !frame_pacer.is_frame_due(now))
+        return 0;
+
+    frame_queued = true;
+    disp.emplace_last<Event>(engine_events::RENDER);
+    return 1;
+}
+
+bool Engine::is_recorded() const { return false; }
+
+EventProducer::Clock::time_point Engine::next_deadline() const {
+    // no hurry while the frame waits for dispatch
+    auto frame_time = is_headless() || frame_queued
+                          ? Clock::time_point::max()
+                          : frame_pacer.get_wake_time();
+    return std::min(tick_start_time + tick_delay, frame_time);
 }
 
 } // namespace redseen::engine
\ No newline at end of file
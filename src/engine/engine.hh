@@ -19,17 +19,27 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <limits>
 #include <string_view>
 #include <memory>
 
 #include "common/noncopyable.hh"
+#include "engine/coroutine.hh"
 #include "engine/event_observer.hh"
 #include "engine/event_producer_container.hh"
 #include "texture_manager.hh"
 #include "object_manager.hh"
 #include "event_dispatcher.hh"
+#include "event_key.hh"
+#include "event_record.hh"
+#include "frame_pacer.hh"
+#include "render_state.hh"
 #include "renderer.hh"
+#include "timer_wheel.hh"
+#include "job_system.hh"
 #include "camera.hh"
 
 namespace redseen::engine {
@@ -40,16 +50,19 @@ enum class PipelinePriority : std::size_t {
     RENDER = 2
 };
 namespace engine_events {
-constexpr std::string_view TICK = "engine.tick";
-constexpr std::string_view UPDATE = "engine.update";
-constexpr std::string_view OBJECT_UPDATE_DONE = "engine.om_update.done";
-constexpr std::string_view RENDER_UPDATE_DONE = "engine.render_update.done";
-constexpr std::string_view RENDER = "engine.render";
-constexpr std::string_view PRESENT = "engine.present";
-constexpr std::string_view RENDER_DONE = "engine.render.done";
+inline const EventKey TICK{"engine.tick"};
+inline const EventKey UPDATE{"engine.update"};
+inline const EventKey OBJECT_UPDATE_DONE{"engine.om_update.done"};
+inline const EventKey RENDER_UPDATE_DONE{"engine.render_update.done"};
+inline const EventKey RENDER{"engine.render"};
+inline const EventKey PRESENT{"engine.present"};
+inline const EventKey RENDER_DONE{"engine.render.done"};
 
 }; // namespace engine_events
 
+/** Channels of the engine's dispatchers in event recordings */
+enum class EventChannel : std::uint8_t { EXTERNAL = 0, INTERNAL = 1 };
+
 enum class EngineFrameState {
     START = 0,
     WAITING_FOR_UPDATE = 1,
@@ -73,8 +86,63 @@ class Engine : NonCopyable,
     std::shared_ptr<TextureManager> texture_manager;
     std::shared_ptr<ObjectManager> object_manager;
     std::shared_ptr<Renderer> renderer;
+    /** Delayed and periodic events for the general dispatcher. It runs on
+    simulation time, moving forward by a tick delay each tick, so a replay
+    fires the timers at the same ticks. */
+    std::shared_ptr<TimerWheel> timer_wheel;
+    /** Threads shared by the engine's parallel work, including the
+     * concurrent observers of both dispatchers */
+    std::shared_ptr<JobSystem> job_system;
+    /** Runs the coroutine tasks on the events of both dispatchers. Delays
+     * count ticks. */
+    std::shared_ptr<CoroutineScheduler> coroutine_scheduler;
     Camera player_camera;
+    /** Time of the last simulated tick */
     std::chrono::time_point<std::chrono::steady_clock> tick_start_time;
+    /** Fixed simulation step */
+    std::chrono::nanoseconds tick_delay = TICK_DELAY;
+    /** Times the rendered frames, independently of the ticks */
+    FramePacer frame_pacer{FRAME_DELAY};
+    /** A RENDER is waiting for dispatch */
+    bool frame_queued = false;
+    /** Applied to the renderer on start and by set_swap_interval */
+    int swap_interval = 0;
+
+    /** Whether the first run has set the engine up */
+    bool started = false;
+    std::atomic<bool> stop_requested = false;
+    /** Queue the ticks back to back instead of at tick_delay */
+    bool unthrottled = false;
+    /** Ticks simulated and queued since the engine was created */
+    std::uint64_t tick_count = 0;
+    /** TICKs queued since the engine was created, including the ones still
+     * waiting for dispatch */
+    std::uint64_t n_queued_ticks = 0;
+    /** Tick count the current run stops at */
+    std::uint64_t tick_limit = NO_TICK_LIMIT;
+    /** Progress between the last two ticks at the frame being rendered */
+    float interpolation_alpha = 1.f;
+
+    /** Whether the ticks are simulated while the previous frame renders */
+    bool pipelined_frames = false;
+    /** Extracted while no ticks are simulated, then drawn while they are */
+    RenderState render_state;
+    /** Ticks to simulate after the next extraction */
+    std::size_t n_pending_ticks = 0;
+    /** Ticks being simulated off the main thread */
+    JobHandle simulation;
+    /** Time a frame may spend on dispatching external events. Whatever
+     * doesn't fit is handled in the next frames. */
+    std::chrono::nanoseconds external_event_budget =
+        DEFAULT_EXTERNAL_EVENT_BUDGET;
+
+    std::shared_ptr<EventRecorder> event_recorder;
+    std::unique_ptr<EventReplayer> external_replayer;
+    std::unique_ptr<EventReplayer> internal_replayer;
+    /** Tick count the replay started at */
+    std::uint64_t replay_first_tick = 0;
+    /** Takes the events of the live recorded producers while replaying */
+    std::unique_ptr<EventDispatcher> muted_event_dispatcher;
 
     class FrameState {
         Engine &engine;
@@ -99,22 +167,86 @@ class Engine : NonCopyable,
 
     void init();
     void init_opengl();
+    /** Subscribe and set up the renderer on the first run */
+    void start();
     void subscribe_dispatcher(EventDispatcher &);
 
     void reset_frame_state();
     void internal_dispatch_loop();
+    void receive_internal_events();
+    /** Sleep until the next deadline of the producers, input or a post */
+    void wait_for_events();
+    void stop_replay();
+    /** Whether the run is recorded or replayed, so the ticks must see the
+     * input in the same order in both */
+    bool is_reproducible() const;
+    /** Queue the replayed input of the ticks simulated so far */
+    void feed_replayed_events();
+    /** Apply the swap interval to the renderer and the pacer */
+    void apply_swap_interval();
 
     void receive_external_events();
     void dispatch_external_events();
     void handle_external_events();
 
-    void handle_frame();
+    /** Advance the simulation by a tick */
+    void simulate_tick();
+    /** Render the current state, interpolated between the last two ticks */
+    void render_frame();
+    /** Extract the render state, then simulate the pending ticks while it's
+     * drawn. The simulation is finished before the frame ends. */
+    void render_pipelined_frame();
+    /** Wait for the ticks being simulated off the main thread */
+    void finish_simulation();
+    /** Finish the simulation, then simulate the pending ticks here */
+    void simulate_pending_ticks();
+
+    /** Queue the TICKs due by now. When the simulation falls too far behind
+     * the missed ticks are dropped. */
+    std::size_t queue_ticks(EventDispatcher &disp,
+                            std::chrono::steady_clock::time_point now);
+    /** Queue a RENDER if a frame is almost due. The rest of the wait is
+     * done precisely by the pacer before rendering. */
+    std::size_t queue_frame(EventDispatcher &disp,
+                            std::chrono::steady_clock::time_point now);
 
   public:
+    static constexpr std::chrono::nanoseconds DEFAULT_EXTERNAL_EVENT_BUDGET =
+        std::chrono::milliseconds(4);
+    static constexpr std::chrono::milliseconds TICK_DELAY{16};
+    static constexpr std::chrono::milliseconds FRAME_DELAY{16};
+    /** Most ticks simulated to catch up at once */
+    static constexpr std::size_t MAX_CONSECUTIVE_TICKS = 32;
+    static constexpr std::uint64_t NO_TICK_LIMIT =
+        std::numeric_limits<std::uint64_t>::max();
+    /** Lane of the window events in the general dispatcher */
+    static constexpr int INPUT_LANE_PRIORITY = 1;
+    static constexpr std::size_t INPUT_LANE_WEIGHT = 8;
+
     static std::shared_ptr<Engine> create();
 
+    /** Run until stop() is called */
     bool run();
 
+    /** Run until a number of ticks has been simulated or stop() is called.
+    Returns the number of ticks simulated. */
+    std::uint64_t run_for(std::uint64_t n_ticks);
+
+    /** Make run() return. Safe to call from any thread. */
+    void stop();
+
+    /** Without a renderer the engine runs headless: no frames are rendered,
+    only the ticks and the dispatchers run */
+    bool is_headless() const;
+
+    /** Simulate the ticks back to back instead of at the tick rate, e.g. for
+     * benchmarks. The step stays tick_delay. */
+    void set_unthrottled(bool enabled);
+    bool is_unthrottled() const;
+
+    /** Number of ticks simulated so far */
+    std::uint64_t get_tick_count() const;
+
     const std::unique_ptr<EventDispatcher> &get_event_dispatcher() const;
     const std::unique_ptr<EventDispatcher> &
     get_internal_event_dispatcher() const;
@@ -128,6 +260,64 @@ class Engine : NonCopyable,
     const std::shared_ptr<ObjectManager> &get_object_manager() const;
     const std::shared_ptr<Renderer> &get_renderer() const;
     void set_renderer(const std::shared_ptr<Renderer> &);
+    const std::shared_ptr<TimerWheel> &get_timer_wheel() const;
+    const std::shared_ptr<JobSystem> &get_job_system() const;
+    const std::shared_ptr<CoroutineScheduler> &get_coroutine_scheduler() const;
+
+    /** Set the fixed simulation step. Each TICK only updates the objects,
+    catching up several ticks runs no rendering. */
+    void set_tick_delay(std::chrono::nanoseconds delay);
+    std::chrono::nanoseconds get_tick_delay() const;
+
+    /** Set the interval between rendered frames. Zero renders after each
+     * pass of the loop. */
+    void set_frame_delay(std::chrono::nanoseconds delay);
+    std::chrono::nanoseconds get_frame_delay() const;
+    /** Set the frame interval from a frame rate, 0 means no limit */
+    void set_frame_rate(double frames_per_second);
+
+    /** Make the present wait for a number of display refreshes, 0 disables
+    vsync. Frames are then paced at whole refresh intervals. */
+    void set_swap_interval(int interval);
+    int get_swap_interval() const;
+
+    /** The pacer of the rendered frames, with the pacing error stats */
+    FramePacer &get_frame_pacer();
+    const FramePacer &get_frame_pacer() const;
+
+    /** How far the frame being rendered is between the previous tick (0)
+    and the last one (1). Objects interpolate their state with it. */
+    float get_interpolation_alpha() const;
+
+    /** Simulate the ticks of a frame on another thread while the frame is
+    drawn. Objects are drawn from the RenderState they extract before the
+    ticks, so one frame late. The dispatchers don't run until the ticks are
+    done, but object updates must not touch them other than through post().
+    Disabled by default. */
+    void set_pipelined_frames(bool enabled);
+    bool is_pipelined_frames() const;
+
+    /** Set the per-frame time budget for external events.
+    std::chrono::nanoseconds::max() disables the limit. The window events go
+    to the urgent input lane, which isn't held by the budget: all of them are
+    dispatched every frame, however long it takes. */
+    void set_external_event_budget(std::chrono::nanoseconds budget);
+    std::chrono::nanoseconds get_external_event_budget() const;
+
+    /** Record the events entering the engine's dispatchers, each one as its
+    EventChannel. The events are stamped with the tick they're handled
+    before. While recording or replaying, the external events are all
+    dispatched at the start of the ticks, whatever the budget, and the frames
+    aren't pipelined. nullptr stops recording. */
+    void record_events(std::shared_ptr<EventRecorder> recorder);
+
+    /** Feed the dispatchers from a recording instead of the recorded
+    producers and other threads until the recording ends. The producers are
+    still polled, but their events are dropped, and so are posts. The ticks
+    run back to back, each one followed by the input recorded before the
+    next. */
+    void replay_events(std::shared_ptr<const EventRecording> recording);
+    bool is_replaying() const;
 
     Camera &get_player_camera();
     const Camera &get_player_camera() const;
@@ -137,6 +327,10 @@ class Engine : NonCopyable,
     ObserverReturnSignal on_event(const Event &) override;
 
     std::size_t feed_dispatcher(EventDispatcher &, bool can_block) override;
+    Clock::time_point next_deadline() const override;
+    /** The ticks and frames follow from the engine's state, a replay
+     * generates them again */
+    bool is_recorded() const override;
 };
 
 } // namespace redseen::engine
\ No newline at end of file
@@ -23,27 +23,71 @@
 #include <iostream>
 #endif
 
+#include <concepts>
 #include <cstdlib>
 #include <string_view>
+#include <typeinfo>
 #include <glm/glm.hpp>
 
+#include "event_key.hh"
+
 namespace redseen::engine {
 
+struct Event;
+
+/** How a dispatcher merges events of the same key which are queued before
+being dispatched. Only the last event of its lane is merged into, so events
+are never reordered: move, click, move queues all three. */
+enum class CoalescePolicy {
+    /** Every event is dispatched */
+    KEEP_ALL,
+    /** The queued event takes the value of the newer one */
+    KEEP_LAST,
+    /** The newer event is folded into the queued one with its coalesce()
+    member, e.g. to accumulate deltas. Types without coalesce() behave like
+    KEEP_LAST. */
+    ACCUMULATE,
+};
+
+/** An event type bound to a single key, exposed by a static event_key().
+Such types can be observed with the typed register_observer<T>. */
+template <class T>
+concept KeyedEvent = std::derived_from<T, Event> && requires {
+    { T::event_key() } -> std::convertible_to<const EventKey &>;
+};
+
 /** Base class for events */
 struct Event {
-    using Key = std::string;
+    using Key = EventKey;
     using KeyView = std::string_view;
 
+    EventId id;
     KeyView name;
 
-    Event(const KeyView &name) : name(name) {
+    Event(const EventKey &key) : id(key.get_id()), name(key.get_name()) {
 #ifdef DEBUG
         std::cerr << "Creating event: " << name << std::endl;
 #endif
     }
 
+    /** Compare by the name. Meant for tools which only know the name. */
     bool has_name(const KeyView &name) const { return this->name == name; }
 
+    /** Compare by the interned id */
+    bool has_name(const EventKey &key) const { return id == key.get_id(); }
+
+    /** Whether the event is exactly of a given type. The key alone doesn't
+    tell, e.g. an event of a typed key may have been queued as a plain Event. */
+    template <class T> bool is_a() const { return typeid(*this) == typeid(T); }
+
+    /** Get the event as a concrete type if it has the type's key and is of
+     * that type */
+    template <KeyedEvent T> const T *get_if() const {
+        if (id != T::event_key().get_id() || !is_a<T>())
+            return nullptr;
+        return static_cast<const T *>(this);
+    }
+
     virtual ~Event() = default;
 };
 
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "event_arena.hh"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace redseen::engine {
+
+void *EventArena::allocate(std::size_t size, std::size_t align) {
+    while (current_chunk < chunks.size()) {
+        auto &chunk = chunks[current_chunk];
+        auto base = reinterpret_cast<std::uintptr_t>(chunk.data.get());
+        auto aligned = (base + offset + align - 1) & ~(align - 1);
+        auto new_offset = aligned - base + size;
+
+        if (new_offset <= chunk.size) {
+            offset = new_offset;
+            return reinterpret_cast<void *>(aligned);
+        }
+
+        // doesn't fit, try the next chunk kept from the previous frames
+        current_chunk++;
+        offset = 0;
+    }
+
+    auto chunk_size = std::max(DEFAULT_CHUNK_SIZE, size + align);
+    chunks.push_back(
+        Chunk{.data = std::make_unique<std::byte[]>(chunk_size),
+              .size = chunk_size});
+    current_chunk = chunks.size() - 1;
+    offset = 0;
+
+    return allocate(size, align);
+}
+
+void EventArena::reset() {
+    current_chunk = 0;
+    offset = 0;
+}
+
+std::size_t EventArena::get_reserved_size() const {
+    std::size_t size = 0;
+    for (const auto &chunk : chunks)
+        size += chunk.size;
+    return size;
+}
+
+std::size_t EventArena::get_used_chunks() const {
+    return std::min(current_chunk + 1, chunks.size());
+}
+
+} // namespace redseen::engine
@@ -0,0 +1,68 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "common/noncopyable.hh"
+
+namespace redseen::engine {
+
+/** A bump allocator for events living no longer than one dispatch.
+Memory is handed out from big chunks and is reclaimed all at once by reset().
+The chunks are kept between resets so a warmed up arena doesn't allocate. */
+class EventArena : NonCopyable {
+    struct Chunk {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    std::vector<Chunk> chunks;
+    std::size_t current_chunk = 0;
+    std::size_t offset = 0;
+
+  public:
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    void *allocate(std::size_t size, std::size_t align);
+
+    /** Construct an object inside the arena.
+    The arena never calls destructors, it's up to the caller. */
+    template <class T, class... Args> T *create(Args &&...args) {
+        void *mem = allocate(sizeof(T), alignof(T));
+        return new (mem) T(std::forward<Args>(args)...);
+    }
+
+    /** Make all memory available again. Objects created in the arena must not
+     * be used afterwards. */
+    void reset();
+
+    /** Total size of the chunks owned by the arena */
+    std::size_t get_reserved_size() const;
+
+    /** Number of chunks handed out from since the last reset */
+    std::size_t get_used_chunks() const;
+};
+
+} // namespace redseen::engine
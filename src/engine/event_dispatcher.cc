@@ -17,101 +17,527 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <iterator>
 #include <limits>
 #include <optional>
+#include <stdexcept>
 #include <string>
-#include <iostream>
+#include <utility>
 #include "event_dispatcher.hh"
 #include "engine/event_observer.hh"
+#include "common/profiler.hh"
 
 namespace redseen::engine {
 
 class Event;
 class Engine;
 
-bool EventDispatcher::register_observer(
-    const std::string_view &observer_name, const Event::KeyView &event_name,
+EventDispatcher::EventDispatcher(std::size_t ingress_capacity)
+    : ingress_queue(ingress_capacity),
+      waker(std::make_shared<EventWaker>()) {
+    add_lane("default", 0);
+}
+
+ObserverHandle EventDispatcher::register_observer(
+    const std::string_view &observer_name, const EventKey &event_key,
     std::size_t priority_class, std::size_t priority,
     const std::weak_ptr<EventObserver> &observer, bool allow_duplicates) {
-    if (allow_duplicates &&
-        find_observer(observer_name, event_name).has_value())
+    return register_observer(observer_name, event_key, priority_class,
+                             priority, observer, ObserverFlags::NONE,
+                             allow_duplicates);
+}
+
+ObserverHandle EventDispatcher::register_observer(
+    const std::string_view &observer_name, const EventKey &event_key,
+    std::size_t priority_class, std::size_t priority,
+    const std::weak_ptr<EventObserver> &observer, ObserverFlags flags,
+    bool allow_duplicates) {
+    return register_observer_thunk(
+        observer_name, event_key, priority_class, priority, observer,
+        static_cast<void *>(observer.lock().get()), call_event_observer, flags,
+        allow_duplicates);
+}
+
+ObserverHandle EventDispatcher::register_observer_thunk(
+    const std::string_view &observer_name, const EventKey &event_key,
+    std::size_t priority_class, std::size_t priority,
+    std::weak_ptr<void> owner, void *observer, ObserverThunk thunk,
+    ObserverFlags flags, bool allow_duplicates) {
+    auto event_id = event_key.get_id();
+
+    if (!allow_duplicates &&
+        !find_observers(observer_name, event_id, true).empty())
+        return {};
+
+    auto handle = allocate_observer_slot();
+    auto &slot = observer_slots[handle.index];
+    slot.name = observer_name;
+    slot.observer = std::move(owner);
+    slot.event_id = event_id;
+    slot.prio = wrap_prio(priority_class, priority);
+    slot.stats_index = get_observer_stats_index(observer_name);
+
+    auto &named = observer_slots_by_name[slot.name][event_id];
+    slot.name_pos = static_cast<std::uint32_t>(named.size());
+    named.push_back(handle.index);
+
+    auto list = copy_current_list(event_id);
+    insert_observer(list, PriorityObserverKey{.prio = slot.prio,
+                                              .handle = handle,
+                                              .observer = observer,
+                                              .thunk = thunk,
+                                              .flags = flags});
+    set_observer_list(event_id, std::move(list));
+
+    return handle;
+}
+
+WildcardHandle EventDispatcher::register_wildcard_observer(
+    const std::string_view &observer_name, const std::string_view &pattern,
+    std::size_t priority_class, std::size_t priority,
+    const std::weak_ptr<EventObserver> &observer, ObserverFlags flags,
+    bool allow_duplicates) {
+    // bring the other subscriptions up to date first, the new one is
+    // matched against every name below
+    if (!wildcard_routes.empty())
+        resolve_wildcards();
+
+    std::uint32_t index;
+    if (!free_wildcard_subscriptions.empty())
+        index = free_wildcard_subscriptions.back();
+    else
+        index = static_cast<std::uint32_t>(wildcard_subscriptions.size());
+
+    // throws on a malformed pattern before anything is changed
+    wildcard_routes.add(pattern, index);
+
+    if (!free_wildcard_subscriptions.empty())
+        free_wildcard_subscriptions.pop_back();
+    else
+        wildcard_subscriptions.emplace_back();
+
+    auto &sub = wildcard_subscriptions[index];
+    sub.pattern = pattern;
+    sub.name = observer_name;
+    sub.priority_class = priority_class;
+    sub.priority = priority;
+    sub.owner = observer;
+    sub.observer = static_cast<void *>(observer.lock().get());
+    sub.thunk = call_event_observer;
+    sub.flags = flags;
+    sub.allow_duplicates = allow_duplicates;
+    sub.used = true;
+
+    const auto &registry = EventRegistry::instance();
+    const auto n_ids = static_cast<EventId>(registry.size());
+    for (EventId event_id = 0; event_id < n_ids; event_id++) {
+        wildcard_matches.clear();
+        wildcard_routes.match(registry.name(event_id), wildcard_matches);
+        if (std::find(wildcard_matches.begin(), wildcard_matches.end(),
+                      index) != wildcard_matches.end())
+            add_wildcard_registration(index, event_id);
+    }
+    wildcard_resolved_ids = n_ids;
+
+    return WildcardHandle{.index = index,
+                          .generation = wildcard_subscriptions[index].generation};
+}
+
+bool EventDispatcher::unregister_wildcard_observer(WildcardHandle handle) {
+    if (handle.index >= wildcard_subscriptions.size())
+        return false;
+
+    const auto &sub = wildcard_subscriptions[handle.index];
+    if (!sub.used || sub.generation != handle.generation)
         return false;
 
-    get_priority_set(event_name)
-        .emplace(wrap_prio(priority_class, priority),
-                 std::string(observer_name), observer);
+    free_wildcard_subscription(handle.index);
+    return true;
+}
+
+bool EventDispatcher::unregister_observer(ObserverHandle handle) {
+    if (!is_observer_registered(handle))
+        return false;
 
+    // entries in the observer list turn stale with the generation bump and
+    // are skipped until the list gets compacted
+    free_observer_slot(handle.index);
     return true;
 }
 
 bool EventDispatcher::unregister_observer(const std::string_view &observer_name,
-                                          const Event::KeyView &event_name) {
-    if (auto query = find_observer(observer_name, event_name);
-        query.has_value()) {
-        query->first.erase(query->second);
-        if (query->first.empty())
-            event_observer_map.erase(std::string(event_name));
-        return true;
-    } else {
+                                          const EventKey &event_key) {
+    auto handles = find_observers(observer_name, event_key.get_id(), true);
+    return !handles.empty() && unregister_observer(handles.front());
+}
+
+bool EventDispatcher::set_observer_priority(ObserverHandle handle,
+                                            std::size_t prio) {
+    if (!is_observer_registered(handle))
         return false;
-    }
+
+    auto &slot = observer_slots[handle.index];
+    slot.prio = prio;
+
+    auto list = copy_current_list(slot.event_id);
+    auto entry = std::find_if(list.entries.begin(), list.entries.end(),
+                              [&](const PriorityObserverKey &key) {
+                                  return key.handle == handle;
+                              });
+    auto key = *entry;
+    key.prio = prio;
+    list.entries.erase(entry);
+    insert_observer(list, key);
+    set_observer_list(slot.event_id, std::move(list));
+
+    return true;
 }
 
 bool EventDispatcher::set_observer_priority(
-    const std::string_view &observer_name, const Event::KeyView &event_name,
+    const std::string_view &observer_name, const EventKey &event_key,
     std::size_t prio, bool include_duplicates) {
+    auto handles =
+        find_observers(observer_name, event_key.get_id(), !include_duplicates);
 
-    auto set_prio_for_one = [&](const ObserverQuery &query) {
-        auto old_key = *query.second;
-        query.first.erase(query.second);
-        query.first.insert(PriorityObserverKey{
-            .prio = prio, .name = old_key.name, .observer = old_key.observer});
-    };
+    for (auto handle : handles)
+        set_observer_priority(handle, prio);
 
-    bool any_removed = false;
+    return !handles.empty();
+}
 
-    std::optional<ObserverQuery> query;
-    while ((query = find_observer(observer_name, event_name)).has_value()) {
-        any_removed = true;
-        set_prio_for_one(*query);
-        if (!include_duplicates)
-            break;
-    }
+bool EventDispatcher::is_observer_registered(ObserverHandle handle) const {
+    return handle.index < observer_slots.size() &&
+           observer_slots[handle.index].used &&
+           observer_slots[handle.index].generation == handle.generation;
+}
 
-    return any_removed;
+void EventDispatcher::set_coalesce_policy(const EventKey &event_key,
+                                          CoalescePolicy policy) {
+    auto event_id = event_key.get_id();
+    if (event_id >= coalesce_policies.size())
+        coalesce_policies.resize(std::size_t(event_id) + 1);
+
+    coalesce_policies[event_id] = policy;
+
+    // events queued under the old policy are left alone
+    if (event_id < coalesce_pending.size())
+        coalesce_pending[event_id] = {};
 }
 
 void EventDispatcher::queue_last(std::shared_ptr<Event> ev) {
-    event_queue.emplace_back(std::move(ev));
+    Event *ev_p = ev.get();
+    if (is_tapped()) [[unlikely]]
+        event_tap->on_event_queued(*this, *ev_p, false);
+
+    push_queued(QueuedEvent{.event = ev_p, .owner = std::move(ev)}, false);
 }
 
 void EventDispatcher::queue_next(std::shared_ptr<Event> ev) {
-    event_queue.emplace_front(std::move(ev));
+    Event *ev_p = ev.get();
+    if (is_tapped()) [[unlikely]]
+        event_tap->on_event_queued(*this, *ev_p, true);
+
+    push_queued(QueuedEvent{.event = ev_p, .owner = std::move(ev)}, true);
+}
+
+bool EventDispatcher::post(std::shared_ptr<Event> ev) {
+    if (!ingress_queue.try_push(std::move(ev)))
+        return false;
+
+    waker->notify();
+    return true;
+}
+
+bool EventDispatcher::has_events() const {
+    return n_queued != 0 || !ingress_queue.empty();
+}
+
+bool EventDispatcher::wait_for_events(EventWaker::Clock::time_point deadline) {
+    if (has_events())
+        return true;
+
+    return waker->wait_until(deadline);
+}
+
+void EventDispatcher::set_waker(std::shared_ptr<EventWaker> waker) {
+    this->waker = std::move(waker);
+}
+
+const std::shared_ptr<EventWaker> &EventDispatcher::get_waker() const {
+    return waker;
+}
+
+void EventDispatcher::set_event_tap(std::shared_ptr<EventTap> tap) {
+    event_tap = std::move(tap);
+}
+
+const std::shared_ptr<EventTap> &EventDispatcher::get_event_tap() const {
+    return event_tap;
 }
 
-void EventDispatcher::drop_queue() { event_queue = {}; }
+void EventDispatcher::begin_input() { input_depth++; }
+
+void EventDispatcher::end_input() { input_depth--; }
+
+void EventDispatcher::set_ingress_muted(bool muted) { ingress_muted = muted; }
 
-std::size_t EventDispatcher::dispatch(std::size_t n) {
+std::uint64_t EventDispatcher::get_dispatch_count() const {
+    return dispatch_count;
+}
+
+void EventDispatcher::drop_queue() {
+    for (auto &lane : lanes) {
+        while (!lane.queue.empty()) {
+            release_event(lane.queue.front());
+            lane.queue.pop_front();
+        }
+        lane.n_next = 0;
+    }
+    n_queued = 0;
+    next_lanes.clear();
+    coalesce_pending.assign(coalesce_pending.size(), {});
+    // an outer dispatch may still be delivering arena events
+    if (dispatch_depth == 0)
+        event_arena.reset();
+}
+
+std::size_t EventDispatcher::dispatch(std::size_t n,
+                                      Clock::time_point deadline) {
+    REDSEEN_PROFILE_ZONE("EventDispatcher::dispatch");
     std::size_t n_dispatched = 0;
 
-#ifdef DEBUG
-    std::cerr << "EventDispatcher::dispatch() Events to dispatch: "
-              << event_queue.size() << std::endl;
-#endif
+    drain_ingress();
+
+    const bool starving = n_deferred_dispatches >= max_deferred_dispatches;
+    const bool has_deadline = deadline != Clock::time_point::max() && !starving;
+
+    // A nested dispatch() gets its own buffers. They're given back even if
+    // an observer throws, with the events taken from the queue released.
+    class Buffers {
+        EventDispatcher &dispatcher;
+
+      public:
+        std::vector<QueuedEvent> batch;
+        std::vector<const Event *> live_events;
+
+        explicit Buffers(EventDispatcher &dispatcher)
+            : dispatcher(dispatcher),
+              batch(std::move(dispatcher.dispatch_batch)),
+              live_events(std::move(dispatcher.dispatch_live_events)) {}
+        ~Buffers() {
+            for (auto &queued : batch)
+                release_event(queued);
+            batch.clear();
+            live_events.clear();
+            dispatcher.dispatch_batch = std::move(batch);
+            dispatcher.dispatch_live_events = std::move(live_events);
+        }
+
+        Buffers(const Buffers &) = delete;
+        Buffers &operator=(const Buffers &) = delete;
+    } buffers(*this);
+    auto &batch = buffers.batch;
+    auto &live_events = buffers.live_events;
 
-    while (!event_queue.empty()) {
-        auto front_ev = std::move(event_queue.front());
-        event_queue.pop_front();
-#ifdef DEBUG
-        std::cerr << "Dispatching: " << front_ev->name << std::endl;
-#endif
-        dispatch_event(*front_ev);
-        n_dispatched++;
+    bool past_deadline = false;
+
+    while (n_queued != 0 && n_dispatched < n) {
+        if (has_deadline && !past_deadline && n_dispatched != 0 &&
+            Clock::now() >= deadline)
+            past_deadline = true;
+
+        // past the deadline only the urgent lanes are left
+        const auto lane_index = pick_lane(past_deadline);
+        if (lane_index == NO_LANE)
+            break;
+        auto &lane = lanes[lane_index];
+        auto &queue = lane.queue;
+
+        const EventId event_id = queue.front().event->id;
+        if (event_id >= wildcard_resolved_ids) [[unlikely]]
+            resolve_wildcards();
+
+        const auto *list = get_observer_list(event_id);
+
+        // consecutive events of the same key are only grouped if someone
+        // takes them in batches, otherwise the order of delivery to
+        // different observers would change
+        do {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+            if (lane.n_next != 0)
+                lane.n_next--;
+            n_queued--;
+            clear_pending_event(*batch.back().event);
+        } while (list != nullptr && list->any_batched && !queue.empty() &&
+                 queue.front().event->id == event_id &&
+                 n_dispatched + batch.size() < n);
+
+        if (stats_enabled) [[unlikely]] {
+            auto now = Clock::now();
+            for (const auto &queued : batch) {
+                // queued before stats got enabled
+                if (queued.queued_at != Clock::time_point{})
+                    lane.latency.add(1, now - queued.queued_at);
+            }
+        }
+
+        for (const auto &queued : batch)
+            live_events.push_back(queued.event);
+
+        if (stats_enabled) [[unlikely]] {
+            auto start = Clock::now();
+            dispatch_events(live_events);
+            record_event_time(event_id, batch.size(), Clock::now() - start);
+        } else {
+            dispatch_events(live_events);
+        }
+        live_events.clear();
+
+        for (auto &queued : batch)
+            release_event(queued);
+        n_dispatched += batch.size();
+        batch.clear();
+    }
+
+    if (n_queued == 0) {
+        // every arena event has been dispatched and destroyed by now, unless
+        // this is a nested dispatch() and the outer one still holds its batch
+        if (dispatch_depth == 0)
+            event_arena.reset();
+        n_deferred_dispatches = 0;
+    } else {
+        // the rest is carried over to the next dispatch, in a fresh arena
+        // once the current one has outgrown a chunk
+        if (dispatch_depth == 0 && event_arena.get_used_chunks() > 1)
+            compact_arena();
+        n_deferred_dispatches++;
     }
 
+    if (stats_enabled && stats_summary_interval != Clock::duration::zero())
+        queue_stats_summary();
+
+    dispatch_count++;
     return n_dispatched;
 }
 
+std::size_t EventDispatcher::dispatch_for(Clock::duration budget,
+                                          std::size_t n) {
+    auto now = Clock::now();
+    auto deadline = budget >= Clock::time_point::max() - now
+                        ? Clock::time_point::max()
+                        : now + budget;
+    return dispatch(n, deadline);
+}
+
+void EventDispatcher::set_max_deferred_dispatches(std::size_t max_deferred) {
+    max_deferred_dispatches = max_deferred;
+}
+
+std::size_t EventDispatcher::get_queue_size() const { return n_queued; }
+
+std::size_t EventDispatcher::add_lane(const std::string_view &name,
+                                      int priority, std::size_t weight,
+                                      bool urgent) {
+    auto index = static_cast<std::uint32_t>(lanes.size());
+    auto &lane = lanes.emplace_back();
+    lane.name = name;
+    lane.priority = priority;
+    lane.weight = std::max<std::size_t>(weight, 1);
+    lane.urgent = urgent;
+    lane.credit = lane.weight;
+
+    auto pos = std::upper_bound(
+        lane_order.begin(), lane_order.end(), priority,
+        [&](int prio, std::uint32_t i) { return prio > lanes[i].priority; });
+    lane_order.insert(pos, index);
+    return index;
+}
+
+void EventDispatcher::set_event_lane(const std::string_view &name,
+                                     std::size_t lane) {
+    if (lane >= lanes.size())
+        throw std::out_of_range("No such event lane");
+
+    if (EventRouteTrie::is_pattern(name))
+        lane_routes.add(name, static_cast<std::uint32_t>(lane));
+    else
+        lanes_by_key[EventKey(name).get_id()] = static_cast<std::uint32_t>(lane);
+
+    // the routes of all ids are found again
+    event_lanes.clear();
+}
+
+std::size_t EventDispatcher::get_lane_count() const { return lanes.size(); }
+
+std::size_t EventDispatcher::get_lane_size(std::size_t lane) const {
+    return lanes.at(lane).queue.size();
+}
+
+std::size_t EventDispatcher::resolve_event_lane(EventId event_id) {
+    const auto &registry = EventRegistry::instance();
+    const auto n_ids =
+        std::max(static_cast<std::size_t>(registry.size()),
+                 static_cast<std::size_t>(event_id) + 1);
+
+    for (auto id = static_cast<EventId>(event_lanes.size()); id < n_ids; id++) {
+        std::uint32_t lane = DEFAULT_LANE;
+
+        if (auto iter = lanes_by_key.find(id); iter != lanes_by_key.end()) {
+            lane = iter->second;
+        } else if (!lane_routes.empty()) {
+            lane_matches.clear();
+            lane_routes.match(registry.name(id), lane_matches);
+            // the longest pattern comes last
+            if (!lane_matches.empty())
+                lane = lane_matches.back();
+        }
+        event_lanes.push_back(lane);
+    }
+    return event_lanes[event_id];
+}
+
+std::size_t EventDispatcher::pick_lane(bool urgent_only) {
+    // the events queued as the next ones go first, the last one first
+    for (auto i = next_lanes.size(); i-- != 0;) {
+        const auto index = next_lanes[i];
+        const auto &lane = lanes[index];
+        if (lane.n_next != 0 && urgent_only && !lane.urgent)
+            continue;
+
+        next_lanes.erase(next_lanes.begin() + i);
+        // unless a batch of its lane has taken the event already
+        if (lane.n_next != 0)
+            return index;
+    }
+
+    if (lanes.size() == 1) {
+        const auto &lane = lanes.front();
+        return lane.queue.empty() || (urgent_only && !lane.urgent)
+                   ? NO_LANE
+                   : DEFAULT_LANE;
+    }
+
+    // the second pass starts a new round once the waiting lanes are out of
+    // credit
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto index : lane_order) {
+            auto &lane = lanes[index];
+            if (lane.queue.empty() || (urgent_only && !lane.urgent))
+                continue;
+            if (lane.credit != 0) {
+                lane.credit--;
+                return index;
+            }
+        }
+
+        for (auto &lane : lanes)
+            lane.credit = lane.weight;
+    }
+    return NO_LANE;
+}
+
 std::size_t EventDispatcher::wrap_prio(std::size_t prefix, std::size_t prio) {
     constexpr auto sizet_bits = std::numeric_limits<std::size_t>::digits;
     constexpr auto shift_bits = sizet_bits / 2;
@@ -132,97 +558,560 @@ EventDispatcher::unwrap_prio(std::size_t wprio) {
     return {wprio >> shift_bits, wprio & low_mask};
 }
 
-bool EventDispatcher::has_priority_set(const Event::KeyView &event_name) {
-    return event_observer_map.contains(std::string(event_name));
+const EventDispatcher::ObserverList *
+EventDispatcher::get_observer_list(EventId event_id) const {
+    if (event_id >= event_observer_table.size())
+        return nullptr;
+    return event_observer_table[event_id].get();
 }
 
-EventDispatcher::ObserverPrioSet &
-EventDispatcher::get_priority_set(const Event::KeyView &event_name) {
-#ifdef DEBUG
-    // std::cerr << "EventDispatcher::get_priority_set: Event sets: ";
-    // for (const auto &pair : event_observer_map) {
-    //     std::cerr << pair.first << ", ";
-    // }
-    // std::cerr << std::endl;
-#endif
-    return event_observer_map[std::string(event_name)];
-}
+void EventDispatcher::set_observer_list(EventId event_id, ObserverList list) {
+    if (event_id >= event_observer_table.size())
+        event_observer_table.resize(std::size_t(event_id) + 1);
 
-std::optional<EventDispatcher::ObserverQuery>
-EventDispatcher::find_observer(const std::string_view &observer_name,
-                               const Event::KeyView &event_name) {
-    const auto event_str = std::string(event_name);
+    auto &slot = event_observer_table[event_id];
 
-    if (!event_observer_map.contains(event_str))
-        return std::nullopt;
+    // a dispatch may be iterating over the old list right now
+    if (dispatch_depth != 0 && slot != nullptr)
+        retired_observer_lists.push_back(std::move(slot));
 
-    auto &obs_set = event_observer_map.at(event_str);
-    auto observer =
-        std::find_if(obs_set.cbegin(), obs_set.cend(),
-                     [&observer_name](const PriorityObserverKey &key) {
-                         return key.name == observer_name;
-                     });
+    list.any_batched = std::any_of(
+        list.entries.cbegin(), list.entries.cend(),
+        [](const PriorityObserverKey &key) {
+            return has_flag(key.flags, ObserverFlags::BATCHED);
+        });
 
-    if (observer != obs_set.cend())
-        return std::make_optional<EventDispatcher::ObserverQuery>(obs_set,
-                                                                  observer);
+    if (list.entries.empty())
+        slot = nullptr;
     else
-        return std::nullopt;
-}
-
-EventDispatcherStatusPair EventDispatcher::dispatch_event_to_observer(
-    ObserverPrioSet &obs_set, ObserverPrioSet::const_iterator observer_iter,
-    const Event &ev) {
-    auto shared_p = observer_iter->observer.lock();
-    if (shared_p != nullptr) {
-#ifdef DEBUG
-        std::cerr << "EventDispatcher: Sending event '" << ev.name << "' to "
-                  << observer_iter->name << std::endl;
-#endif
-        return {true, shared_p->on_event(ev)};
+        slot = std::make_unique<const ObserverList>(std::move(list));
+}
+
+std::vector<ObserverHandle>
+EventDispatcher::find_observers(const std::string_view &observer_name,
+                                EventId event_id, bool first_only) const {
+    std::vector<ObserverHandle> handles;
+
+    auto by_name = observer_slots_by_name.find(std::string(observer_name));
+    if (by_name == observer_slots_by_name.end())
+        return handles;
+
+    auto by_event = by_name->second.find(event_id);
+    if (by_event == by_name->second.end())
+        return handles;
+
+    for (auto index : by_event->second) {
+        handles.push_back(
+            {.index = index, .generation = observer_slots[index].generation});
+        if (first_only)
+            break;
+    }
+    return handles;
+}
+
+ObserverHandle EventDispatcher::allocate_observer_slot() {
+    std::uint32_t index;
+    if (!free_observer_slots.empty()) {
+        index = free_observer_slots.back();
+        free_observer_slots.pop_back();
     } else {
-        // weak pointer to an observer is expired so remove it
-        // from the observer set.
-        remove_observer_from_set(ev.name, observer_iter);
-        return {false, ObserverReturnSignal::CONTINUE};
+        index = static_cast<std::uint32_t>(observer_slots.size());
+        observer_slots.emplace_back();
+    }
+
+    auto &slot = observer_slots[index];
+    slot.used = true;
+    return {.index = index, .generation = slot.generation};
+}
+
+void EventDispatcher::free_observer_slot(std::uint32_t index) {
+    auto &slot = observer_slots[index];
+
+    // the last registration of the name and event takes the freed position
+    auto by_name = observer_slots_by_name.find(slot.name);
+    auto by_event = by_name->second.find(slot.event_id);
+    auto &indices = by_event->second;
+    auto moved = indices.back();
+    indices[slot.name_pos] = moved;
+    observer_slots[moved].name_pos = slot.name_pos;
+    indices.pop_back();
+
+    if (indices.empty()) {
+        by_name->second.erase(by_event);
+        if (by_name->second.empty())
+            observer_slots_by_name.erase(by_name);
+    }
+
+    slot.name.clear();
+    slot.observer.reset();
+    slot.used = false;
+    slot.generation++;
+    free_observer_slots.push_back(index);
+}
+
+bool EventDispatcher::is_entry_current(const PriorityObserverKey &entry) const {
+    const auto &slot = observer_slots[entry.handle.index];
+    return slot.used && slot.generation == entry.handle.generation;
+}
+
+EventDispatcher::ObserverList
+EventDispatcher::copy_current_list(EventId event_id) const {
+    ObserverList list;
+
+    const auto *old_list = get_observer_list(event_id);
+    if (old_list == nullptr)
+        return list;
+
+    list.entries.reserve(old_list->entries.size() + 1);
+    std::copy_if(
+        old_list->entries.cbegin(), old_list->entries.cend(),
+        std::back_inserter(list.entries),
+        [this](const PriorityObserverKey &key) { return is_entry_current(key); });
+    return list;
+}
+
+void EventDispatcher::insert_observer(ObserverList &list,
+                                      PriorityObserverKey key) {
+    auto pos = std::upper_bound(
+        list.entries.begin(), list.entries.end(), key.prio,
+        [](std::size_t prio, const PriorityObserverKey &oth) {
+            return prio < oth.prio;
+        });
+    list.entries.insert(pos, key);
+}
+
+std::shared_ptr<void>
+EventDispatcher::lock_observer(const PriorityObserverKey &observer) {
+    auto &slot = observer_slots[observer.handle.index];
+
+    // unregistered since the list was published
+    if (slot.generation != observer.handle.generation || !slot.used)
+        return nullptr;
+
+    auto owner = slot.observer.lock();
+    if (owner == nullptr) {
+        // the observer is gone without unregistering, free its slot
+        free_observer_slot(observer.handle.index);
+        n_expired_observers++;
+    }
+    return owner;
+}
+
+ObserverReturnSignal
+EventDispatcher::call_observer(const PriorityObserverKey &observer,
+                               const Event &ev) {
+    if (stats_enabled) [[unlikely]] {
+        // the observer may unregister itself, so the slot is read first
+        auto stats_index = observer_slots[observer.handle.index].stats_index;
+        auto start = Clock::now();
+        auto signal = observer.thunk(observer.observer, ev);
+        record_observer_time(stats_index, 1, Clock::now() - start);
+        return signal;
     }
+    return observer.thunk(observer.observer, ev);
 }
 
-bool EventDispatcher::dispatch_event(const Event &ev) {
+EventDispatcherStatusPair EventDispatcher::dispatch_batch_to_observer(
+    const PriorityObserverKey &observer, std::span<const Event *const> events) {
+    auto owner = lock_observer(observer);
+    if (owner == nullptr)
+        return {false, ObserverReturnSignal::CONTINUE};
 
-#ifdef DEBUG
-    // std::cerr << "EventDispatcher::dispatch_event: pre check" << std::endl;
-#endif
+    // only EventObservers can be registered as batched
+    auto *target = static_cast<EventObserver *>(observer.observer);
 
-    if (!has_priority_set(ev.name))
+    if (stats_enabled) [[unlikely]] {
+        auto stats_index = observer_slots[observer.handle.index].stats_index;
+        auto start = Clock::now();
+        auto signal = target->on_events(events);
+        record_observer_time(stats_index, events.size(),
+                             Clock::now() - start);
+        return {true, signal};
+    }
+    return {true, target->on_events(events)};
+}
+
+bool EventDispatcher::dispatch_events(std::vector<const Event *> &events) {
+    const EventId event_id = events.front()->id;
+
+    // the list is immutable, (un)registering during dispatch publishes a new
+    // one and keeps this one alive until we're done
+    const auto *list = get_observer_list(event_id);
+    if (list == nullptr)
         return false;
 
     bool any_notified = false;
-    auto &prio_set = get_priority_set(ev.name);
+    bool any_stale = false;
+
+    // an observer may throw, the depth must come back down all the same
+    class DepthScope {
+        EventDispatcher &dispatcher;
+
+      public:
+        explicit DepthScope(EventDispatcher &dispatcher)
+            : dispatcher(dispatcher) {
+            dispatcher.dispatch_depth++;
+        }
+        ~DepthScope() {
+            if (--dispatcher.dispatch_depth == 0)
+                dispatcher.retired_observer_lists.clear();
+        }
+
+        DepthScope(const DepthScope &) = delete;
+        DepthScope &operator=(const DepthScope &) = delete;
+    };
 
-#ifdef DEBUG
-    std::cerr << "Observers in set for '" << ev.name << "': " << prio_set.size()
-              << std::endl;
-#endif
+    std::optional<DepthScope> depth_scope(std::in_place, *this);
+    for (std::size_t pos = 0; pos < list->entries.size(); pos++) {
+        const auto &observer = list->entries[pos];
+
+        if (observer_executor != nullptr &&
+            has_flag(observer.flags, ObserverFlags::CONCURRENT)) {
+            auto group_end = pos + 1;
+            while (group_end < list->entries.size() &&
+                   list->entries[group_end].prio == observer.prio &&
+                   has_flag(list->entries[group_end].flags,
+                            ObserverFlags::CONCURRENT))
+                group_end++;
+
+            if (group_end - pos > 1) {
+                dispatch_concurrent(
+                    std::span(list->entries).subspan(pos, group_end - pos),
+                    events, any_notified, any_stale);
+                pos = group_end - 1;
+
+                if (events.empty())
+                    break;
+                continue;
+            }
+        }
+
+        if (has_flag(observer.flags, ObserverFlags::BATCHED)) {
+            auto result = dispatch_batch_to_observer(observer, events);
+            if (!result.first) {
+                any_stale = true;
+                continue;
+            }
 
-    for (auto iter = prio_set.cbegin(); iter != prio_set.cend(); iter++) {
-        auto result = dispatch_event_to_observer(prio_set, iter, ev);
-        if (result.first) {
             any_notified = true;
             if (should_event_be_dropped(result.second))
-                break;
+                events.clear();
+        } else {
+            // held for the whole run, the observer may drop its last other
+            // reference from on_event
+            auto owner = lock_observer(observer);
+            if (owner == nullptr) {
+                any_stale = true;
+                continue;
+            }
+
+            std::size_t n_kept = 0;
+            std::size_t i = 0;
+            for (; i < events.size(); i++) {
+                if (i != 0 && !is_entry_current(observer)) {
+                    // unregistered itself, skip the rest of the run
+                    any_stale = true;
+                    break;
+                }
+
+                any_notified = true;
+                auto signal = call_observer(observer, *events[i]);
+                if (!should_event_be_dropped(signal))
+                    events[n_kept++] = events[i];
+            }
+            for (; i < events.size(); i++)
+                events[n_kept++] = events[i];
+            events.resize(n_kept);
         }
+
+        if (events.empty())
+            break;
     }
+    depth_scope.reset();
+
+    if (any_stale)
+        compact_observer_list(event_id);
+
     return any_notified;
 }
 
-void EventDispatcher::remove_observer_from_set(
-    const Event::KeyView &obs_set_key, ObserverPrioSet::const_iterator iter) {
-    auto key_str = std::string(obs_set_key);
-    auto &obs_set = event_observer_map.at(key_str);
-    obs_set.erase(iter);
-    if (obs_set.empty())
-        event_observer_map.erase(key_str);
+void EventDispatcher::dispatch_concurrent(
+    std::span<const PriorityObserverKey> group,
+    std::vector<const Event *> &events, bool &any_notified,
+    bool &any_stale) {
+    // locking may free slots, so it's done before going parallel
+    concurrent_group.clear();
+    concurrent_owners.clear();
+    for (const auto &observer : group) {
+        if (auto owner = lock_observer(observer)) {
+            concurrent_group.push_back(&observer);
+            concurrent_owners.push_back(std::move(owner));
+        } else {
+            any_stale = true;
+        }
+    }
+
+    if (concurrent_group.empty())
+        return;
+    any_notified = true;
+
+    const auto n_events = events.size();
+    concurrent_drops.assign(concurrent_group.size() * n_events, 0);
+    if (stats_enabled)
+        concurrent_times.assign(concurrent_group.size(), {});
+
+    observer_executor->run(concurrent_group.size(), [&](std::size_t i) {
+        const auto &observer = *concurrent_group[i];
+        char *drops = concurrent_drops.data() + i * n_events;
+        const auto start = stats_enabled ? Clock::now() : Clock::time_point{};
+
+        if (has_flag(observer.flags, ObserverFlags::BATCHED)) {
+            auto signal = static_cast<EventObserver *>(observer.observer)
+                              ->on_events(events);
+            if (should_event_be_dropped(signal))
+                std::fill(drops, drops + n_events, 1);
+        } else {
+            for (std::size_t k = 0; k < n_events; k++)
+                drops[k] = should_event_be_dropped(
+                    observer.thunk(observer.observer, *events[k]));
+        }
+
+        // the counters are shared, they're updated after the join
+        if (stats_enabled)
+            concurrent_times[i] = Clock::now() - start;
+    });
+    concurrent_owners.clear();
+
+    if (stats_enabled) {
+        for (std::size_t i = 0; i < concurrent_group.size(); i++)
+            record_observer_time(
+                observer_slots[concurrent_group[i]->handle.index].stats_index,
+                n_events, concurrent_times[i]);
+    }
+
+    // an event dropped by any observer of the group is gone for the next
+    // priorities
+    std::size_t n_kept = 0;
+    for (std::size_t k = 0; k < n_events; k++) {
+        bool dropped = false;
+        for (std::size_t i = 0; i < concurrent_group.size() && !dropped; i++)
+            dropped = concurrent_drops[i * n_events + k] != 0;
+
+        if (!dropped)
+            events[n_kept++] = events[k];
+    }
+    events.resize(n_kept);
+}
+
+void EventDispatcher::set_stats_enabled(bool enabled) {
+    stats_enabled = enabled;
+    last_stats_summary = Clock::now();
+}
+
+bool EventDispatcher::is_stats_enabled() const { return stats_enabled; }
+
+DispatcherStats EventDispatcher::get_stats() const {
+    DispatcherStats stats;
+
+    const auto &registry = EventRegistry::instance();
+    for (EventId event_id = 0; event_id < event_stats.size(); event_id++) {
+        if (event_stats[event_id].count != 0)
+            stats.events.push_back({.name = std::string(registry.name(event_id)),
+                                    .counters = event_stats[event_id]});
+    }
+
+    for (std::size_t i = 0; i < observer_stats.size(); i++) {
+        if (observer_stats[i].count != 0)
+            stats.observers.push_back(
+                {.name = observer_stats_names[i], .counters = observer_stats[i]});
+    }
+
+    for (const auto &lane : lanes)
+        stats.lanes.push_back({.name = lane.name,
+                               .size = lane.queue.size(),
+                               .latency = lane.latency});
+
+    stats.queue_high_water = queue_high_water;
+    stats.expired_observers = n_expired_observers;
+    return stats;
+}
+
+void EventDispatcher::reset_stats() {
+    std::fill(event_stats.begin(), event_stats.end(), DispatchCounters{});
+    std::fill(observer_stats.begin(), observer_stats.end(),
+              DispatchCounters{});
+    for (auto &lane : lanes)
+        lane.latency = {};
+    queue_high_water = 0;
+    n_expired_observers = 0;
+}
+
+void EventDispatcher::set_stats_summary_interval(Clock::duration interval) {
+    stats_summary_interval = interval;
+    last_stats_summary = Clock::now();
+}
+
+std::uint32_t
+EventDispatcher::get_observer_stats_index(const std::string_view &name) {
+    auto iter = observer_stats_indices.find(std::string(name));
+    if (iter != observer_stats_indices.end())
+        return iter->second;
+
+    auto index = static_cast<std::uint32_t>(observer_stats.size());
+    observer_stats.emplace_back();
+    observer_stats_names.emplace_back(name);
+    observer_stats_indices.emplace(name, index);
+    return index;
+}
+
+void EventDispatcher::record_observer_time(std::uint32_t stats_index,
+                                           std::uint64_t n_events,
+                                           Clock::duration time) {
+    observer_stats[stats_index].add(n_events, time);
+}
+
+void EventDispatcher::record_event_time(EventId event_id,
+                                        std::uint64_t n_events,
+                                        Clock::duration time) {
+    if (event_id >= event_stats.size())
+        event_stats.resize(std::size_t(event_id) + 1);
+    event_stats[event_id].add(n_events, time);
+}
+
+void EventDispatcher::queue_stats_summary() {
+    auto now = Clock::now();
+    if (now - last_stats_summary < stats_summary_interval)
+        return;
+
+    last_stats_summary = now;
+    emplace_last<DispatcherStatsEvent>(get_stats());
+}
+
+void EventDispatcher::set_observer_executor(
+    std::shared_ptr<ObserverExecutor> executor) {
+    observer_executor = std::move(executor);
+}
+
+const std::shared_ptr<ObserverExecutor> &
+EventDispatcher::get_observer_executor() const {
+    return observer_executor;
+}
+
+ObserverReturnSignal EventDispatcher::call_event_observer(void *observer,
+                                                         const Event &ev) {
+    return static_cast<EventObserver *>(observer)->on_event(ev);
+}
+
+void EventDispatcher::compact_observer_list(EventId event_id) {
+    set_observer_list(event_id, copy_current_list(event_id));
+}
+
+void EventDispatcher::set_pending_event(EventId event_id,
+                                        PendingEvent pending) {
+    if (event_id >= coalesce_pending.size())
+        coalesce_pending.resize(std::size_t(event_id) + 1);
+
+    coalesce_pending[event_id] = pending;
+}
+
+void EventDispatcher::resolve_wildcards() {
+    const auto &registry = EventRegistry::instance();
+    const auto n_ids = static_cast<EventId>(registry.size());
+
+    for (EventId event_id = wildcard_resolved_ids; event_id < n_ids;
+         event_id++) {
+        wildcard_matches.clear();
+        wildcard_routes.match(registry.name(event_id), wildcard_matches);
+        for (auto index : wildcard_matches)
+            add_wildcard_registration(index, event_id);
+    }
+
+    if (wildcard_resolved_ids != NO_WILDCARDS)
+        wildcard_resolved_ids = n_ids;
+}
+
+void EventDispatcher::add_wildcard_registration(std::uint32_t index,
+                                                EventId event_id) {
+    auto &sub = wildcard_subscriptions[index];
+    if (!sub.used)
+        return;
+
+    // the observer is gone without unregistering, its registrations are
+    // freed as they're met by dispatch
+    if (sub.owner.expired()) {
+        free_wildcard_subscription(index);
+        return;
+    }
+
+    auto handle = register_observer_thunk(
+        sub.name, EventKey(EventRegistry::instance().name(event_id)),
+        sub.priority_class, sub.priority, sub.owner, sub.observer, sub.thunk,
+        sub.flags, sub.allow_duplicates);
+    if (handle.is_valid())
+        sub.handles.push_back(handle);
+}
+
+void EventDispatcher::free_wildcard_subscription(std::uint32_t index) {
+    auto &sub = wildcard_subscriptions[index];
+
+    for (auto handle : sub.handles)
+        unregister_observer(handle);
+
+    wildcard_routes.remove(sub.pattern, index);
+    sub.handles.clear();
+    sub.owner.reset();
+    sub.used = false;
+    sub.generation++;
+    free_wildcard_subscriptions.push_back(index);
+
+    if (wildcard_routes.empty())
+        wildcard_resolved_ids = NO_WILDCARDS;
+}
+
+void EventDispatcher::drain_ingress() {
+    std::shared_ptr<Event> ev;
+    if (ingress_muted) {
+        while (ingress_queue.try_pop(ev))
+            ev.reset();
+        return;
+    }
+
+    begin_input();
+    while (ingress_queue.try_pop(ev))
+        queue_last(std::move(ev));
+    end_input();
+}
+
+void EventDispatcher::compact_arena() {
+    for (const auto &lane : lanes) {
+        for (std::size_t i = 0; i < lane.queue.size(); i++) {
+            const auto &queued = lane.queue[i];
+            if (queued.owner == nullptr && queued.relocate == nullptr)
+                return;
+        }
+    }
+
+    for (auto &lane : lanes) {
+        for (std::size_t i = 0; i < lane.queue.size(); i++) {
+            auto &queued = lane.queue[i];
+            if (queued.owner != nullptr)
+                continue;
+
+            auto *moved = queued.relocate(queued.event, spare_arena);
+            if (moved->id < coalesce_pending.size() &&
+                coalesce_pending[moved->id].event == queued.event)
+                coalesce_pending[moved->id].event = moved;
+            queued.event = moved;
+        }
+    }
+
+    event_arena.reset();
+    std::swap(event_arena, spare_arena);
+}
+
+void EventDispatcher::release_event(QueuedEvent &queued) {
+    if (queued.owner == nullptr)
+        queued.event->~Event();
 }
 
 bool EventDispatcher::should_event_be_dropped(ObserverReturnSignal signal) {
@@ -19,87 +19,557 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
 #include <functional>
 #include <limits>
 #include <optional>
-#include <queue>
-#include <unordered_map>
-#include <set>
+#include <span>
 #include <string>
 #include <string_view>
 #include <memory>
+#include <new>
+#include <unordered_map>
+#include <vector>
 
+#include "common/mpsc_queue.hh"
+#include "common/ring_deque.hh"
 #include "event.hh"
+#include "event_arena.hh"
+#include "event_key.hh"
+#include "event_route_trie.hh"
+#include "event_stats.hh"
+#include "event_waker.hh"
 #include "event_observer.hh"
 
 namespace redseen::engine {
 
 class Event;
 class Engine;
+class EventDispatcher;
+
+/** Runs the concurrent observers of a priority level in parallel */
+class ObserverExecutor {
+  public:
+    /** Call fn for every index in [0, n) and return once all the calls are
+     * done */
+    virtual void run(std::size_t n,
+                     const std::function<void(std::size_t)> &fn) = 0;
+
+    virtual ~ObserverExecutor() = default;
+};
+
+/** Sees the input of a dispatcher: the events fed by producers between
+begin_input() and end_input(), and the ones posted from other threads.
+Events the engine generates itself, by observers, timers or the dispatcher's
+own stats, aren't reported, as a replay generates them again. */
+class EventTap {
+  public:
+    /** Called for every tapped event before it's queued. front tells whether
+     * it goes to the front of the queue. */
+    virtual void on_event_queued(const EventDispatcher &, const Event &,
+                                 bool front) = 0;
+
+    virtual ~EventTap() = default;
+};
+
+/** Identifies a registration of an observer for a single event.
+The slot of a removed registration gets reused with a bumped generation, so
+stale handles never refer to another registration. */
+struct ObserverHandle {
+    static constexpr std::uint32_t INVALID_INDEX =
+        std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t index = INVALID_INDEX;
+    std::uint32_t generation = 0;
+
+    bool is_valid() const { return index != INVALID_INDEX; }
+    bool operator==(const ObserverHandle &) const = default;
+};
+
+/** Identifies a wildcard registration, see register_wildcard_observer */
+struct WildcardHandle {
+    static constexpr std::uint32_t INVALID_INDEX =
+        std::numeric_limits<std::uint32_t>::max();
 
+    std::uint32_t index = INVALID_INDEX;
+    std::uint32_t generation = 0;
+
+    bool is_valid() const { return index != INVALID_INDEX; }
+    bool operator==(const WildcardHandle &) const = default;
+};
+
+/** Calls an observer stored as a type erased pointer */
+using ObserverThunk = ObserverReturnSignal (*)(void *observer, const Event &);
+
+/** An entry of a per event observer list */
 struct PriorityObserverKey {
     std::size_t prio;
-    std::string name;
-    std::weak_ptr<EventObserver> observer;
+    ObserverHandle handle;
+    void *observer;
+    ObserverThunk thunk;
+    ObserverFlags flags = ObserverFlags::NONE;
 };
 
-} // namespace redseen::engine
-
-template <> struct std::less<redseen::engine::PriorityObserverKey> {
-    bool operator()(const redseen::engine::PriorityObserverKey &a,
-                    const redseen::engine::PriorityObserverKey &b) const {
-        return std::less<decltype(a.prio)>{}(a.prio, b.prio);
-    }
+/** State of a single registration */
+struct ObserverSlot {
+    std::string name;
+    std::weak_ptr<void> observer;
+    EventId event_id = 0;
+    std::size_t prio = 0;
+    /** Index of the counters of the observer's name */
+    std::uint32_t stats_index = 0;
+    /** Position in the observer_slots_by_name entry of its name and event */
+    std::uint32_t name_pos = 0;
+    std::uint32_t generation = 0;
+    bool used = false;
 };
 
-namespace redseen::engine {
+/** A registration for every event matching a pattern. It's resolved into
+ * ordinary registrations, one per matching event. */
+struct WildcardSubscription {
+    std::string pattern;
+    std::string name;
+    std::size_t priority_class = 0;
+    std::size_t priority = 0;
+    std::weak_ptr<void> owner;
+    void *observer = nullptr;
+    ObserverThunk thunk = nullptr;
+    ObserverFlags flags = ObserverFlags::NONE;
+    bool allow_duplicates = false;
+    std::vector<ObserverHandle> handles;
+    std::uint32_t generation = 0;
+    bool used = false;
+};
 
 using EventDispatcherStatusPair = std::pair<bool, ObserverReturnSignal>;
 
+/** An entry of the event queue. Events created in the dispatcher's arena
+have no owner and are destroyed by the dispatcher after being dispatched. */
+struct QueuedEvent {
+    Event *event = nullptr;
+    std::shared_ptr<Event> owner;
+    /** Moves an arena event into another arena, nullptr if its type can't
+     * be moved */
+    Event *(*relocate)(Event *, EventArena &) = nullptr;
+    /** Only set while stats are enabled, for the lane latency */
+    EventWaker::Clock::time_point queued_at{};
+};
+
 class EventDispatcher {
   public:
-    using ObserverPrioSet = std::multiset<PriorityObserverKey>;
-    using ObserverMap = std::unordered_map<Event::Key, ObserverPrioSet>;
-
-    ObserverMap event_observer_map;
-    std::deque<std::shared_ptr<Event>> event_queue;
+    using Clock = EventWaker::Clock;
+
+    /** Observers of a single event sorted by priority. Lists are immutable
+    once published, every modification publishes a new copy. */
+    struct ObserverList {
+        std::vector<PriorityObserverKey> entries;
+        /** Whether any of the observers takes events in batches */
+        bool any_batched = false;
+    };
+    /** Observer lists indexed directly by EventId */
+    using ObserverTable = std::vector<std::unique_ptr<const ObserverList>>;
+
+    ObserverTable event_observer_table;
+    std::vector<ObserverSlot> observer_slots;
+    std::vector<std::uint32_t> free_observer_slots;
+    /** Slot indices of registrations by observer name and event, for the
+    name based API */
+    std::unordered_map<std::string,
+                       std::unordered_map<EventId, std::vector<std::uint32_t>>>
+        observer_slots_by_name;
+    /** Lists replaced while being iterated by dispatch. They are freed once
+    the outermost dispatch_event returns. */
+    std::vector<std::unique_ptr<const ObserverList>> retired_observer_lists;
+    std::size_t dispatch_depth = 0;
+    /** Buffers reused by dispatch() */
+    std::vector<QueuedEvent> dispatch_batch;
+    std::vector<const Event *> dispatch_live_events;
+
+    /** A queue of its own for some of the events. Each round of draining a
+    lane dispatches up to its weight of events (a batch counts as one). */
+    struct EventLane {
+        std::string name;
+        int priority = 0;
+        std::size_t weight = 1;
+        /** Drained even once the dispatch deadline has passed */
+        bool urgent = false;
+        RingDeque<QueuedEvent> queue;
+        /** Events left in the current round */
+        std::size_t credit = 0;
+        /** Events queued as the next ones, at the front of the queue */
+        std::size_t n_next = 0;
+        DispatchCounters latency;
+    };
+
+    /** Lanes by index, the first one is the default lane */
+    std::vector<EventLane> lanes;
+    /** Lane indices by descending priority */
+    std::vector<std::uint32_t> lane_order;
+    /** Lane of every interned event id, filled lazily */
+    std::vector<std::uint32_t> event_lanes;
+    std::unordered_map<EventId, std::uint32_t> lanes_by_key;
+    EventRouteTrie lane_routes;
+    std::vector<std::uint32_t> lane_matches;
+    /** Lanes of the events queued as the next ones, the last one on top.
+    They're dispatched before the weighted pick, latest first, the same as
+    in a single queue. */
+    std::vector<std::uint32_t> next_lanes;
+    /** Events in all lanes */
+    std::size_t n_queued = 0;
+    /** Storage of the queued events created by emplace_last/emplace_next.
+    It's reset each time the queue is drained. When it isn't, the events
+    carried over are moved to the spare arena, which becomes the next
+    generation, so a queue which never drains doesn't grow the arena. */
+    EventArena event_arena;
+    EventArena spare_arena;
+    /** Events posted from other threads, moved to the lanes by dispatch() */
+    MpscQueue<std::shared_ptr<Event>> ingress_queue;
+    std::shared_ptr<EventWaker> waker;
+
+    std::vector<WildcardSubscription> wildcard_subscriptions;
+    std::vector<std::uint32_t> free_wildcard_subscriptions;
+    /** Indices of wildcard_subscriptions by pattern */
+    EventRouteTrie wildcard_routes;
+    /** Event ids below this one have been matched against the wildcard
+    routes. Names interned later are matched the first time an event with a
+    higher id gets dispatched. */
+    EventId wildcard_resolved_ids = NO_WILDCARDS;
+    std::vector<std::uint32_t> wildcard_matches;
+
+    std::shared_ptr<EventTap> event_tap;
+    /** Nesting of begin_input() */
+    std::size_t input_depth = 0;
+    bool ingress_muted = false;
+
+    std::shared_ptr<ObserverExecutor> observer_executor;
+    /** Buffers reused for concurrent groups of observers */
+    std::vector<const PriorityObserverKey *> concurrent_group;
+    /** The observers of concurrent_group, locked until the group joins */
+    std::vector<std::shared_ptr<void>> concurrent_owners;
+    std::vector<char> concurrent_drops;
+    std::vector<Clock::duration> concurrent_times;
+
+    /** Whether deliveries are counted and timed */
+    bool stats_enabled = false;
+    /** Counters by EventId */
+    std::vector<DispatchCounters> event_stats;
+    /** Counters by observer name, indexed by ObserverSlot::stats_index */
+    std::vector<DispatchCounters> observer_stats;
+    std::vector<std::string> observer_stats_names;
+    std::unordered_map<std::string, std::uint32_t> observer_stats_indices;
+    std::size_t queue_high_water = 0;
+    std::uint64_t n_expired_observers = 0;
+    Clock::duration stats_summary_interval = Clock::duration::zero();
+    Clock::time_point last_stats_summary;
+
+    /** Number of finished dispatch() calls */
+    std::uint64_t dispatch_count = 0;
+
+    /** Number of dispatches in a row which left events in the queue */
+    std::size_t n_deferred_dispatches = 0;
+    std::size_t max_deferred_dispatches = DEFAULT_MAX_DEFERRED_DISPATCHES;
+
+    /** A queued event later events of the same key can be merged into */
+    struct PendingEvent {
+        Event *event = nullptr;
+        /** Identifies the concrete type of the event */
+        const void *type_tag = nullptr;
+    };
+
+    /** Per event id overrides of the coalescing policy */
+    std::vector<std::optional<CoalescePolicy>> coalesce_policies;
+    /** Per event id queued events which are still open for coalescing, the
+     * last ones of their lanes */
+    std::vector<PendingEvent> coalesce_pending;
 
   public:
-    bool register_observer(const std::string_view &observer_name,
-                           const Event::KeyView &event_name,
-                           std::size_t priority_class, std::size_t priority,
-                           const std::weak_ptr<EventObserver> &,
-                           bool allow_duplicates = false);
-
-    bool
+    static constexpr std::size_t DEFAULT_INGRESS_CAPACITY = 4096;
+    static constexpr std::size_t DEFAULT_MAX_DEFERRED_DISPATCHES = 4;
+    static constexpr EventId NO_WILDCARDS = std::numeric_limits<EventId>::max();
+    static constexpr std::size_t DEFAULT_LANE = 0;
+    static constexpr std::size_t NO_LANE = std::numeric_limits<std::size_t>::max();
+
+    EventDispatcher(std::size_t ingress_capacity = DEFAULT_INGRESS_CAPACITY);
+
+    /** Register an observer for an event.
+    Returns an invalid handle if an observer with the same name is already
+    registered for the event and allow_duplicates is false. */
+    ObserverHandle register_observer(const std::string_view &observer_name,
+                                     const EventKey &event_key,
+                                     std::size_t priority_class,
+                                     std::size_t priority,
+                                     const std::weak_ptr<EventObserver> &,
+                                     bool allow_duplicates = false);
+
+    ObserverHandle register_observer(const std::string_view &observer_name,
+                                     const EventKey &event_key,
+                                     std::size_t priority_class,
+                                     std::size_t priority,
+                                     const std::weak_ptr<EventObserver> &,
+                                     ObserverFlags flags,
+                                     bool allow_duplicates = false);
+
+    std::vector<ObserverHandle>
     register_observer(const std::string_view &observer_name,
-                      const std::initializer_list<Event::KeyView> &event_names,
+                      const std::initializer_list<EventKey> &event_keys,
                       std::size_t priority_class, std::size_t priority,
                       const std::weak_ptr<EventObserver> &observer,
                       bool allow_duplicates = false) {
-        for (const auto &event_name : event_names) {
-            register_observer(observer_name, event_name, priority_class,
-                              priority, observer, allow_duplicates);
+        return register_observer(observer_name, event_keys, priority_class,
+                                 priority, observer, ObserverFlags::NONE,
+                                 allow_duplicates);
+    }
+
+    std::vector<ObserverHandle>
+    register_observer(const std::string_view &observer_name,
+                      const std::initializer_list<EventKey> &event_keys,
+                      std::size_t priority_class, std::size_t priority,
+                      const std::weak_ptr<EventObserver> &observer,
+                      ObserverFlags flags, bool allow_duplicates = false) {
+        std::vector<ObserverHandle> handles;
+        handles.reserve(event_keys.size());
+        for (const auto &event_key : event_keys) {
+            handles.push_back(register_observer(
+                observer_name, event_key, priority_class, priority, observer,
+                flags, allow_duplicates));
+        }
+        return handles;
+    }
+
+    /** Register an observer receiving events of a concrete type.
+    The observer needs an on_event(const T &) member but it doesn't have to
+    derive from EventObserver. The call is resolved at compile time, so
+    there's neither a name compare nor a virtual call when dispatching.
+    Events of the key which aren't of type T are skipped. */
+    template <KeyedEvent T, class O>
+        requires requires(O &observer, const T &ev) {
+            { observer.on_event(ev) } -> std::same_as<ObserverReturnSignal>;
         }
-        return true;
+    ObserverHandle register_observer(const std::string_view &observer_name,
+                                     std::size_t priority_class,
+                                     std::size_t priority,
+                                     const std::weak_ptr<O> &observer,
+                                     bool allow_duplicates = false) {
+        return register_observer_thunk(
+            observer_name, T::event_key(), priority_class, priority, observer,
+            static_cast<void *>(observer.lock().get()),
+            [](void *target, const Event &ev) {
+                if (!ev.is_a<T>()) [[unlikely]] {
+#ifdef DEBUG
+                    std::cerr << "EventDispatcher: skipping " << ev.name
+                              << ", it isn't of the observed type"
+                              << std::endl;
+#endif
+                    return ObserverReturnSignal::CONTINUE;
+                }
+                return static_cast<O *>(target)->on_event(
+                    static_cast<const T &>(ev));
+            },
+            ObserverFlags::NONE, allow_duplicates);
     }
 
+    template <KeyedEvent T, class O>
+    ObserverHandle register_observer(const std::string_view &observer_name,
+                                     std::size_t priority_class,
+                                     std::size_t priority,
+                                     const std::shared_ptr<O> &observer,
+                                     bool allow_duplicates = false) {
+        return register_observer<T>(observer_name, priority_class, priority,
+                                    std::weak_ptr<O>(observer),
+                                    allow_duplicates);
+    }
+
+    /** Register an observer for every event matching a pattern like
+    "window.*", including the events whose names get interned later.
+    The pattern is resolved into ordinary registrations, so dispatching costs
+    the same as with exact ones. Throws std::invalid_argument for malformed
+    patterns, see EventRouteTrie. */
+    WildcardHandle
+    register_wildcard_observer(const std::string_view &observer_name,
+                               const std::string_view &pattern,
+                               std::size_t priority_class, std::size_t priority,
+                               const std::weak_ptr<EventObserver> &observer,
+                               ObserverFlags flags = ObserverFlags::NONE,
+                               bool allow_duplicates = false);
+
+    /** Remove a wildcard registration along with the registrations it has
+    been resolved into. Returns false if the handle is stale. */
+    bool unregister_wildcard_observer(WildcardHandle handle);
+
+    /** Remove a registration. O(1), the observer list is compacted lazily.
+    Returns false if the handle is stale. */
+    bool unregister_observer(ObserverHandle handle);
+
     bool unregister_observer(const std::string_view &observer_name,
-                             const Event::KeyView &event_name);
+                             const EventKey &event_key);
+
+    /** Change the (wrapped) priority of a registration.
+    Returns false if the handle is stale. */
+    bool set_observer_priority(ObserverHandle handle, std::size_t prio);
 
     bool set_observer_priority(const std::string_view &observer_name,
-                               const Event::KeyView &event_name,
+                               const EventKey &event_key,
                                std::size_t prio,
                                bool include_duplicates = false);
 
+    /** Check whether a handle still refers to a registration */
+    bool is_observer_registered(ObserverHandle handle) const;
+
     void queue_last(std::shared_ptr<Event>);
     void queue_next(std::shared_ptr<Event>);
 
+    /** Construct an event in the dispatcher's arena and queue it as the last
+    one. The event lives until it's dispatched, but may be moved within the
+    arena by the dispatches which don't get to it. */
+    template <std::derived_from<Event> T, class... Args>
+    T &emplace_last(Args &&...args) {
+        if constexpr (std::move_constructible<T>) {
+            if (is_tapped()) [[unlikely]] {
+                // the tap has to see the event before it's merged
+                T ev(std::forward<Args>(args)...);
+                event_tap->on_event_queued(*this, ev, false);
+                return emplace_last_untapped<T>(std::move(ev));
+            }
+        }
+        return emplace_last_untapped<T>(std::forward<Args>(args)...);
+    }
+
+    /** Construct an event in the dispatcher's arena and queue it as the next
+    one. The event lives until it's dispatched, but may be moved within the
+    arena by the dispatches which don't get to it. */
+    template <std::derived_from<Event> T, class... Args>
+    T &emplace_next(Args &&...args) {
+        T *ev = event_arena.create<T>(std::forward<Args>(args)...);
+        if (is_tapped()) [[unlikely]]
+            event_tap->on_event_queued(*this, *ev, true);
+
+        push_queued(QueuedEvent{.event = ev,
+                                .owner = nullptr,
+                                .relocate = get_relocate<T>()},
+                    true);
+        return *ev;
+    }
+
+    /** Set how events of a given key queued by emplace_last are merged.
+    Overrides the default policy of the event type. */
+    void set_coalesce_policy(const EventKey &event_key, CoalescePolicy policy);
+
+    /** Get the policy applied to events of a given type, which is the
+    dispatcher's override or the type's static coalesce_policy member */
+    template <KeyedEvent T> CoalescePolicy get_coalesce_policy() const {
+        auto event_id = T::event_key().get_id();
+        if (event_id < coalesce_policies.size() &&
+            coalesce_policies[event_id].has_value())
+            return *coalesce_policies[event_id];
+
+        if constexpr (requires { T::coalesce_policy; })
+            return T::coalesce_policy;
+        else
+            return CoalescePolicy::KEEP_ALL;
+    }
+
+    /** Queue an event from any thread. The event will be queued as the last
+    one at the start of the next dispatch() and the waker will be notified.
+    Returns false if the ingress queue is full. */
+    bool post(std::shared_ptr<Event>);
+
+    /** Check whether there's anything to dispatch, including the events
+     * posted from other threads */
+    bool has_events() const;
+
+    /** Block until an event is posted or the deadline passes.
+    Returns true without blocking if there's already something to dispatch.
+    Must be called from the dispatching thread. */
+    bool wait_for_events(EventWaker::Clock::time_point deadline);
+
+    /** Share a waker between dispatchers so a single thread can sleep until
+     * any of them gets work */
+    void set_waker(std::shared_ptr<EventWaker>);
+    const std::shared_ptr<EventWaker> &get_waker() const;
+
     /** Drop all events in the queue */
     void drop_queue();
 
+    /** Count and time deliveries per event key and per observer name.
+    Disabled by default, when disabled the cost is a branch per delivery.
+    The queue high-water mark and expired observers are always counted. */
+    void set_stats_enabled(bool enabled);
+    bool is_stats_enabled() const;
+
+    DispatcherStats get_stats() const;
+    void reset_stats();
+
+    /** Queue a DispatcherStatsEvent every given interval while stats are
+     * enabled. Zero disables it. */
+    void set_stats_summary_interval(Clock::duration interval);
+
+    /** Set the executor running ObserverFlags::CONCURRENT observers. Without
+     * one they're called one after another like the others. */
+    void set_observer_executor(std::shared_ptr<ObserverExecutor>);
+    const std::shared_ptr<ObserverExecutor> &get_observer_executor() const;
+
+    /** Set a tap seeing the events entering the dispatcher, e.g. an
+     * EventRecorder. nullptr removes it. */
+    void set_event_tap(std::shared_ptr<EventTap>);
+    const std::shared_ptr<EventTap> &get_event_tap() const;
+
+    /** Mark the events queued until end_input() as input from outside the
+    engine, shown to the tap. Producer containers do it around the feeds of
+    recorded producers. Calls can be nested. */
+    void begin_input();
+    void end_input();
+
+    /** Drop the events posted from other threads instead of queueing them,
+     * e.g. while a recording stands in for them */
+    void set_ingress_muted(bool muted);
+
+    /** Number of finished dispatch() calls. Events queued before a
+     * dispatch() get the count it had before it ran. */
+    std::uint64_t get_dispatch_count() const;
+
+    /** Dispatch at most n events, stopping early once the deadline passes.
+    Events which didn't make it stay queued for the next call. At least one
+    event is always dispatched, and if the deadline has cut the previous
+    calls short too many times in a row (see set_max_deferred_dispatches)
+    the deadline is ignored so that old events can't starve.
+    Returns the number of dispatched events. */
     std::size_t
-    dispatch(std::size_t n = std::numeric_limits<std::size_t>::max());
+    dispatch(std::size_t n = std::numeric_limits<std::size_t>::max(),
+             Clock::time_point deadline = Clock::time_point::max());
+
+    /** Dispatch events for at most a given amount of time */
+    std::size_t
+    dispatch_for(Clock::duration budget,
+                 std::size_t n = std::numeric_limits<std::size_t>::max());
+
+    /** Set after how many deadline-limited dispatches in a row the deadline
+     * gets ignored */
+    void set_max_deferred_dispatches(std::size_t max_deferred);
+
+    /** Number of events waiting for dispatch, not counting the ones posted
+     * from other threads since the last dispatch */
+    std::size_t get_queue_size() const;
+
+    /** Add a queue lane and return its index. Lanes of higher priority are
+    drained first, but every lane gets to dispatch up to its weight of events
+    per round, so bulk lanes still progress. Urgent lanes ignore the
+    dispatch deadline. Events go to the default lane (priority 0, weight 1)
+    unless routed elsewhere by set_event_lane. */
+    std::size_t add_lane(const std::string_view &name, int priority,
+                         std::size_t weight = 1, bool urgent = false);
+
+    /** Route the events of a key, or of a pattern like "window.*", to a lane.
+    Keys take precedence over patterns and longer patterns over shorter
+    ones. Events queued already stay in their lanes.
+    Throws std::out_of_range if there's no such lane. */
+    void set_event_lane(const std::string_view &name, std::size_t lane);
+
+    std::size_t get_lane_count() const;
+    /** Number of events waiting in a lane */
+    std::size_t get_lane_size(std::size_t lane) const;
 
     /** Wrap priority to be used as priority for registering observers.
     Engine's internal prefix is 0. */
@@ -110,28 +580,217 @@ class EventDispatcher {
     unwrap_prio(std::size_t wrapped_prio);
 
   protected:
-    using ObserverQuery =
-        std::pair<ObserverPrioSet &, ObserverPrioSet::const_iterator>;
+    template <class T> static constexpr char type_tag = 0;
+
+    /** Whether events being queued now have to be shown to the tap */
+    bool is_tapped() const {
+        return event_tap != nullptr && input_depth != 0 && dispatch_depth == 0;
+    }
+
+    template <std::derived_from<Event> T, class... Args>
+    T &emplace_last_untapped(Args &&...args) {
+        if constexpr (KeyedEvent<T>) {
+            if (T *pending = coalesce<T>(std::forward<Args>(args)...))
+                return *pending;
+        }
+
+        T *ev = event_arena.create<T>(std::forward<Args>(args)...);
+        push_queued(QueuedEvent{.event = ev,
+                                .owner = nullptr,
+                                .relocate = get_relocate<T>()},
+                    false);
+
+        if constexpr (KeyedEvent<T>) {
+            if (get_coalesce_policy<T>() != CoalescePolicy::KEEP_ALL)
+                set_pending_event(T::event_key().get_id(),
+                                  {.event = ev, .type_tag = &type_tag<T>});
+        }
+        return *ev;
+    }
+
+    /** Merge a new event into a queued one of the same type according to
+    the coalescing policy. Returns nullptr if the event has to be queued. */
+    template <KeyedEvent T, class... Args> T *coalesce(Args &&...args) {
+        auto policy = get_coalesce_policy<T>();
+        if (policy == CoalescePolicy::KEEP_ALL)
+            return nullptr;
+
+        auto event_id = T::event_key().get_id();
+        if (event_id >= coalesce_pending.size())
+            return nullptr;
+
+        const auto &pending = coalesce_pending[event_id];
+        if (pending.event == nullptr || pending.type_tag != &type_tag<T>)
+            return nullptr;
+
+        T *pending_ev = static_cast<T *>(pending.event);
+
+        if constexpr (requires(T &a, const T &b) { a.coalesce(b); }) {
+            if (policy == CoalescePolicy::ACCUMULATE) {
+                pending_ev->coalesce(T(std::forward<Args>(args)...));
+                return pending_ev;
+            }
+        }
+
+        pending_ev->~T();
+        return new (pending_ev) T(std::forward<Args>(args)...);
+    }
+
+    void set_pending_event(EventId event_id, PendingEvent pending);
+
+    template <std::derived_from<Event> T>
+    static constexpr auto get_relocate() -> decltype(QueuedEvent::relocate) {
+        if constexpr (std::move_constructible<T>) {
+            return [](Event *ev, EventArena &arena) -> Event * {
+                auto *from = static_cast<T *>(ev);
+                T *to = arena.create<T>(std::move(*from));
+                from->~T();
+                return to;
+            };
+        } else {
+            return nullptr;
+        }
+    }
+
+    /** Move the arena events still queued into a new arena generation and
+     * reclaim the old one. Does nothing if an event can't be moved. */
+    void compact_arena();
 
-    bool has_priority_set(const Event::KeyView &event_name);
+    std::size_t get_event_lane(EventId event_id) {
+        if (event_id < event_lanes.size()) [[likely]]
+            return event_lanes[event_id];
+        return resolve_event_lane(event_id);
+    }
+
+    /** Find the lanes of the ids interned since the last call */
+    std::size_t resolve_event_lane(EventId event_id);
+
+    void push_queued(QueuedEvent queued, bool front) {
+        auto lane_index = get_event_lane(queued.event->id);
+        auto &lane = lanes[lane_index];
+
+        if (stats_enabled) [[unlikely]]
+            queued.queued_at = Clock::now();
+
+        if (front) {
+            lane.queue.push_front(std::move(queued));
+            lane.n_next++;
+            next_lanes.push_back(std::uint32_t(lane_index));
+        } else {
+            // merging into the event behind this one would reorder them
+            if (!lane.queue.empty())
+                clear_pending_event(*lane.queue.back().event);
+            lane.queue.push_back(std::move(queued));
+        }
+        n_queued++;
+        // tracked whether stats are enabled or not, it's as cheap as the
+        // check would be
+        queue_high_water = std::max(queue_high_water, n_queued);
+    }
+
+    /** Choose the lane to dispatch from next, or NO_LANE if there's nothing
+     * to dispatch */
+    std::size_t pick_lane(bool urgent_only);
+
+    /** Close an event for coalescing, as it's about to be dispatched or an
+     * event has been queued after it */
+    void clear_pending_event(const Event &ev) {
+        if (ev.id < coalesce_pending.size() &&
+            coalesce_pending[ev.id].event == &ev)
+            coalesce_pending[ev.id] = {};
+    }
+
+    ObserverHandle register_observer_thunk(const std::string_view &observer_name,
+                                           const EventKey &event_key,
+                                           std::size_t priority_class,
+                                           std::size_t priority,
+                                           std::weak_ptr<void> owner,
+                                           void *observer, ObserverThunk thunk,
+                                           ObserverFlags flags,
+                                           bool allow_duplicates);
+
+    /** Thunk of observers registered through the EventObserver interface */
+    static ObserverReturnSignal call_event_observer(void *observer,
+                                                    const Event &ev);
+
+    /** Gets the observer list of a given event id or nullptr if there are no
+     * observers */
+    const ObserverList *get_observer_list(EventId event_id) const;
+
+    /** Publish a new observer list for a given event id. The replaced list
+     * stays valid until no dispatch iterates over it. */
+    void set_observer_list(EventId event_id, ObserverList list);
+
+    /** Find registrations of a named observer for an event */
+    std::vector<ObserverHandle>
+    find_observers(const std::string_view &observer_name, EventId event_id,
+                   bool first_only) const;
+
+    ObserverHandle allocate_observer_slot();
+    void free_observer_slot(std::uint32_t index);
 
-    /** Gets the priority set for a given event key. If it doesn't exist, a new
-     * one is created. */
-    ObserverPrioSet &get_priority_set(const Event::KeyView &event_name);
+    /** Check whether a list entry still refers to a live registration */
+    bool is_entry_current(const PriorityObserverKey &entry) const;
 
-    std::optional<ObserverQuery>
-    find_observer(const std::string_view &observer_name,
-                  const Event::KeyView &event_name);
+    /** Copy the current list of an event without stale entries */
+    ObserverList copy_current_list(EventId event_id) const;
+
+    /** Insert an observer after the ones with the same or higher priority */
+    static void insert_observer(ObserverList &list, PriorityObserverKey key);
+
+    /** Keep the observer of a list entry alive while it's called. Returns
+     * nullptr if the entry is stale, and frees the registration if the
+     * observer has been destroyed without unregistering. */
+    std::shared_ptr<void> lock_observer(const PriorityObserverKey &observer);
+
+    /** Call a locked observer with a single event */
+    ObserverReturnSignal call_observer(const PriorityObserverKey &observer,
+                                       const Event &ev);
 
     EventDispatcherStatusPair
-    dispatch_event_to_observer(ObserverPrioSet &obs_set,
-                               ObserverPrioSet::const_iterator observer_iter,
-                               const Event &ev);
+    dispatch_batch_to_observer(const PriorityObserverKey &observer,
+                               std::span<const Event *const> events);
+
+    /** Get the index of the counters of an observer name, adding them if
+     * needed */
+    std::uint32_t get_observer_stats_index(const std::string_view &name);
+
+    void record_observer_time(std::uint32_t stats_index,
+                              std::uint64_t n_events, Clock::duration time);
+    void record_event_time(EventId event_id, std::uint64_t n_events,
+                           Clock::duration time);
+
+    /** Queue a DispatcherStatsEvent if the summary interval has passed */
+    void queue_stats_summary();
+
+    /** Dispatch events to a group of concurrent observers of the same
+    priority and remove the events dropped by any of them */
+    void dispatch_concurrent(std::span<const PriorityObserverKey> group,
+                             std::vector<const Event *> &events,
+                             bool &any_notified, bool &any_stale);
+
+    /** Dispatch a run of events of the same key. Events dropped by an
+    observer are removed from the vector. Observers taking batches get the
+    whole run at once, the others get the events one by one. */
+    bool dispatch_events(std::vector<const Event *> &events);
+
+    /** Match the names interned since the last call against the wildcard
+     * routes */
+    void resolve_wildcards();
+
+    /** Register a wildcard subscription for a single event */
+    void add_wildcard_registration(std::uint32_t index, EventId event_id);
+
+    void free_wildcard_subscription(std::uint32_t index);
+
+    /** Move the events posted from other threads to the event queue */
+    void drain_ingress();
 
-    bool dispatch_event(const Event &ev);
+    /** Destroy an event popped from the queue if the dispatcher owns it */
+    static void release_event(QueuedEvent &queued);
 
-    void remove_observer_from_set(const Event::KeyView &obs_set_key,
-                                  ObserverPrioSet::const_iterator iter);
+    /** Remove stale entries from the list of an event */
+    void compact_observer_list(EventId event_id);
 
     /** Check if a given event should be dropped */
     static bool should_event_be_dropped(ObserverReturnSignal);
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "event_key.hh"
+
+namespace redseen::engine {
+
+EventRegistry &EventRegistry::instance() {
+    static EventRegistry registry;
+    return registry;
+}
+
+EventId EventRegistry::intern(const std::string_view &name) {
+    std::lock_guard lock(mutex);
+
+    if (auto iter = ids.find(name); iter != ids.end())
+        return iter->second;
+
+    auto id = static_cast<EventId>(names.size());
+    // std::deque doesn't move its elements on push_back so the views stay
+    // valid
+    const auto &stored = names.emplace_back(name);
+    ids.emplace(stored, id);
+    return id;
+}
+
+std::optional<EventId>
+EventRegistry::find(const std::string_view &name) const {
+    std::lock_guard lock(mutex);
+
+    if (auto iter = ids.find(name); iter != ids.end())
+        return iter->second;
+    return std::nullopt;
+}
+
+std::string_view EventRegistry::name(EventId id) const {
+    std::lock_guard lock(mutex);
+    return names.at(id);
+}
+
+std::size_t EventRegistry::size() const {
+    std::lock_guard lock(mutex);
+    return names.size();
+}
+
+} // namespace redseen::engine
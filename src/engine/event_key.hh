@@ -0,0 +1,82 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace redseen::engine {
+
+/** Dense integer identifier of an interned event name */
+using EventId = std::uint32_t;
+
+/** Process-wide table mapping event names to dense ids.
+Ids are handed out in registration order starting from 0, so they can be used
+to index flat tables directly. Names are never unregistered. */
+class EventRegistry {
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, EventId> ids;
+    mutable std::mutex mutex;
+
+    EventRegistry() = default;
+
+  public:
+    static EventRegistry &instance();
+
+    /** Get the id of a given name, registering it if it wasn't seen before */
+    EventId intern(const std::string_view &name);
+
+    /** Get the id of a given name without registering it */
+    std::optional<EventId> find(const std::string_view &name) const;
+
+    /** Get the name of an interned id.
+    Throws std::out_of_range if the id wasn't handed out by this registry. */
+    std::string_view name(EventId id) const;
+
+    /** Number of interned names. Every id is lower than this value. */
+    std::size_t size() const;
+};
+
+/** An event name resolved to its id once, on construction.
+Event name constants should be declared as EventKeys so that neither
+dispatching nor comparing them needs to touch the name. */
+class EventKey {
+    std::string_view name;
+    EventId id;
+
+  public:
+    EventKey(const std::string_view &name)
+        : name(name), id(EventRegistry::instance().intern(name)) {
+        // point to the registry's copy so runtime built names stay valid
+        this->name = EventRegistry::instance().name(id);
+    }
+
+    EventId get_id() const { return id; }
+    std::string_view get_name() const { return name; }
+
+    bool operator==(const EventKey &oth) const { return id == oth.id; }
+};
+
+} // namespace redseen::engine
@@ -18,6 +18,9 @@
  */
 
 #pragma once
+
+#include <span>
+
 namespace redseen::engine {
 
 struct Event;
@@ -27,9 +30,43 @@ enum class ObserverReturnSignal {
     DROP_EVENT,
 };
 
+/** Options of an observer registration */
+enum class ObserverFlags : unsigned {
+    NONE = 0,
+    /** Deliver runs of consecutive events of the same key at once through
+    EventObserver::on_events */
+    BATCHED = 1 << 0,
+    /** May run in parallel with the other concurrent observers of the same
+    priority, on the dispatcher's ObserverExecutor. Such observers must not
+    touch the dispatcher other than through post(), and dropping an event
+    only hides it from the later priorities. */
+    CONCURRENT = 1 << 1,
+};
+
+constexpr ObserverFlags operator|(ObserverFlags a, ObserverFlags b) {
+    return ObserverFlags(unsigned(a) | unsigned(b));
+}
+
+constexpr bool has_flag(ObserverFlags flags, ObserverFlags flag) {
+    return (unsigned(flags) & unsigned(flag)) != 0;
+}
+
 class EventObserver {
   public:
     virtual ObserverReturnSignal on_event(const Event &) = 0;
+
+    /** Receive consecutive queued events of the same key at once. Called
+    instead of on_event when registered with ObserverFlags::BATCHED.
+    Returning DROP_EVENT drops all of the events. */
+    virtual ObserverReturnSignal
+    on_events(std::span<const Event *const> events) {
+        auto signal = ObserverReturnSignal::CONTINUE;
+        for (const Event *ev : events) {
+            if (on_event(*ev) == ObserverReturnSignal::DROP_EVENT)
+                signal = ObserverReturnSignal::DROP_EVENT;
+        }
+        return signal;
+    }
 };
 
 } // namespace redseen::engine
\ No newline at end of file
@@ -28,7 +28,37 @@ class EventDispatcher;
 /** EventProducers are a direct feed of events for an event dispatcher */
 class EventProducer {
   public:
+    using Clock = std::chrono::steady_clock;
+
     virtual std::size_t feed_dispatcher(EventDispatcher &, bool can_block) = 0;
+
+    /** The latest time the producer has to be fed again, e.g. when its next
+     * timer fires. Clock::time_point::max() if it only reacts to the outside
+     * world. */
+    virtual Clock::time_point next_deadline() const {
+        return Clock::time_point::max();
+    }
+
+    /** Whether the producer can put the thread to sleep until its own events
+    arrive, like a window waiting in its event loop. */
+    virtual bool can_wait() const { return false; }
+
+    /** Sleep until the producer's events arrive, wake() is called or the
+    deadline passes, feeding the events which arrived into the dispatcher.
+    Only called if can_wait() is true. Returns the number of fed events. */
+    virtual std::size_t wait_until(EventDispatcher &, Clock::time_point) {
+        return 0;
+    }
+
+    /** Interrupt wait_until(). Safe to call from any thread. */
+    virtual void wake() {}
+
+    /** Whether the producer's events are input to be recorded. Producers
+    whose events follow from the engine's own state, like its ticks, return
+    false, a replay generates their events again. */
+    virtual bool is_recorded() const { return true; }
+
+    virtual ~EventProducer() = default;
 };
 
 } // namespace redseen::engine
\ No newline at end of file
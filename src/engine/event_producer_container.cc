@@ -20,17 +20,92 @@
 #include "event_producer_container.hh"
 #include "event_dispatcher.hh"
 
+#include <algorithm>
+
 namespace redseen::engine {
 
+namespace {
+
+/** Marks the events of recorded producers as the dispatcher's input */
+class InputScope {
+    EventDispatcher *dispatcher = nullptr;
+
+  public:
+    InputScope(EventDispatcher &dispatcher, const EventProducer &producer) {
+        if (producer.is_recorded()) {
+            this->dispatcher = &dispatcher;
+            dispatcher.begin_input();
+        }
+    }
+    ~InputScope() {
+        if (dispatcher != nullptr)
+            dispatcher->end_input();
+    }
+
+    InputScope(const InputScope &) = delete;
+    InputScope &operator=(const InputScope &) = delete;
+};
+
+} // namespace
+
 std::size_t EventProducerContainer::feed_dispatcher(EventDispatcher &dispatcher,
                                                     bool can_block) {
+    return feed_dispatcher(dispatcher, dispatcher, can_block);
+}
+
+std::size_t
+EventProducerContainer::feed_dispatcher(EventDispatcher &dispatcher,
+                                        EventDispatcher &input_dispatcher,
+                                        bool can_block) {
     std::size_t n_fed = 0;
     for (auto &producer : producers) {
-        n_fed += producer.second->feed_dispatcher(dispatcher, can_block);
+        auto &target =
+            producer.second->is_recorded() ? input_dispatcher : dispatcher;
+        InputScope input(target, *producer.second);
+        n_fed += producer.second->feed_dispatcher(target, can_block);
     }
     return n_fed;
 }
 
+EventProducer::Clock::time_point EventProducerContainer::next_deadline() const {
+    auto deadline = EventProducer::Clock::time_point::max();
+    for (const auto &producer : producers)
+        deadline = std::min(deadline, producer.second->next_deadline());
+    return deadline;
+}
+
+EventProducer *EventProducerContainer::get_waiting_producer() const {
+    for (const auto &producer : producers) {
+        if (producer.second->can_wait())
+            return producer.second.get();
+    }
+    return nullptr;
+}
+
+std::size_t
+EventProducerContainer::wait_until(EventDispatcher &dispatcher,
+                                   EventProducer::Clock::time_point deadline) {
+    auto *waiting = get_waiting_producer();
+    if (waiting == nullptr) {
+        dispatcher.wait_for_events(deadline);
+        return 0;
+    }
+
+    if (dispatcher.has_events())
+        return 0;
+
+    auto &waker = *dispatcher.get_waker();
+    std::size_t n_fed = 0;
+
+    if (waker.begin_external_wait([waiting] { waiting->wake(); })) {
+        InputScope input(dispatcher, *waiting);
+        n_fed = waiting->wait_until(dispatcher, deadline);
+    }
+    waker.end_external_wait();
+
+    return n_fed;
+}
+
 bool EventProducerContainer::add_producer(
     const std::string_view &name, std::shared_ptr<EventProducer> producer) {
     return producers.insert(std::make_pair(name, std::move(producer))).second;
@@ -34,6 +34,26 @@ class EventProducerContainer {
   public:
     std::size_t feed_dispatcher(EventDispatcher &, bool can_block = false);
 
+    /** Feed the recorded producers into another dispatcher than the rest,
+     * e.g. a muted one while a recording stands in for their input */
+    std::size_t feed_dispatcher(EventDispatcher &,
+                                EventDispatcher &input_dispatcher,
+                                bool can_block = false);
+
+    /** Earliest deadline of the producers */
+    EventProducer::Clock::time_point next_deadline() const;
+
+    /** A producer which can sleep the thread waiting for its events, or
+     * nullptr */
+    EventProducer *get_waiting_producer() const;
+
+    /** Sleep until the dispatcher's waker is notified, a producer able to
+    wait gets its events or the deadline passes. With such a producer the
+    wait happens inside of it and notifications wake it up, otherwise the
+    dispatcher's waker is waited on. Returns the number of fed events. */
+    std::size_t wait_until(EventDispatcher &,
+                           EventProducer::Clock::time_point deadline);
+
     bool add_producer(const std::string_view &name,
                       std::shared_ptr<EventProducer> producer);
     bool remove_producer(const std::string_view &name);
@@ -0,0 +1,268 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "event_record.hh"
+
+#include <algorithm>
+#include <array>
+#ifdef DEBUG
+#include <iostream>
+#endif
+
+namespace redseen::engine {
+
+static constexpr std::array<char, 8> RECORDING_MAGIC = {'R', 'S', 'E', 'V',
+                                                        'R', 'E', 'C', '\0'};
+
+void EventWriter::write_string(const std::string_view &str) {
+    write(static_cast<std::uint32_t>(str.size()));
+    auto offset = buffer.size();
+    buffer.resize(offset + str.size());
+    std::memcpy(buffer.data() + offset, str.data(), str.size());
+}
+
+std::span<const std::byte> EventReader::read_bytes(std::size_t size) {
+    if (size > data.size() - pos)
+        throw std::out_of_range("EventReader: read past the end");
+
+    auto taken = data.subspan(pos, size);
+    pos += size;
+    return taken;
+}
+
+std::string_view EventReader::read_string() {
+    auto size = read<std::uint32_t>();
+    auto bytes = read_bytes(size);
+    return {reinterpret_cast<const char *>(bytes.data()), bytes.size()};
+}
+
+EventCodecRegistry &EventCodecRegistry::instance() {
+    static EventCodecRegistry registry;
+    return registry;
+}
+
+void EventCodecRegistry::add(EventId event_id, EventCodec codec) {
+    std::lock_guard lock(mutex);
+
+    if (event_id >= codecs.size())
+        codecs.resize(event_id + 1);
+    codecs[event_id] = codec;
+}
+
+std::optional<EventCodec> EventCodecRegistry::find(EventId event_id) const {
+    std::lock_guard lock(mutex);
+
+    if (event_id >= codecs.size())
+        return std::nullopt;
+    return codecs[event_id];
+}
+
+// written field by field to keep records free of padding
+void EventRecording::write_header(EventWriter &writer,
+                                  const EventHeader &header) {
+    writer.write(header.channel);
+    writer.write(static_cast<std::uint8_t>(header.front));
+    writer.write(static_cast<std::uint8_t>(header.typed));
+    writer.write(header.tick);
+    writer.write(header.name_index);
+    writer.write(header.size);
+}
+
+EventRecording::EventHeader EventRecording::read_header(EventReader &reader) {
+    EventHeader header;
+    header.channel = reader.read<std::uint8_t>();
+    header.front = reader.read<std::uint8_t>() != 0;
+    header.typed = reader.read<std::uint8_t>() != 0;
+    header.tick = reader.read<std::uint64_t>();
+    header.name_index = reader.read<std::uint32_t>();
+    header.size = reader.read<std::uint32_t>();
+    return header;
+}
+
+void EventRecording::save(std::ostream &out) const {
+    std::vector<std::byte> header;
+    EventWriter writer(header);
+    writer.write(RECORDING_MAGIC);
+    writer.write(FORMAT_VERSION);
+    writer.write(static_cast<std::uint64_t>(data.size()));
+
+    out.write(reinterpret_cast<const char *>(header.data()), header.size());
+    out.write(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+EventRecording EventRecording::load(std::istream &in) {
+    std::array<std::byte, sizeof(RECORDING_MAGIC) + sizeof(std::uint32_t) +
+                              sizeof(std::uint64_t)>
+        header;
+    if (!in.read(reinterpret_cast<char *>(header.data()), header.size()))
+        throw std::runtime_error("EventRecording: truncated header");
+
+    EventReader reader(header);
+    if (reader.read<std::array<char, 8>>() != RECORDING_MAGIC)
+        throw std::runtime_error("EventRecording: not an event recording");
+    if (reader.read<std::uint32_t>() != FORMAT_VERSION)
+        throw std::runtime_error("EventRecording: unsupported version");
+
+    EventRecording recording;
+    recording.data.resize(reader.read<std::uint64_t>());
+    if (!in.read(reinterpret_cast<char *>(recording.data.data()),
+                 recording.data.size()))
+        throw std::runtime_error("EventRecording: truncated data");
+
+    return recording;
+}
+
+std::shared_ptr<EventRecorder> EventRecorder::create() {
+    struct SharedHelper : public EventRecorder {};
+    return std::make_shared<SharedHelper>();
+}
+
+void EventRecorder::attach(EventDispatcher &disp, std::uint8_t channel,
+                           TickSource tick_source) {
+    channels[&disp] =
+        Channel{.id = channel, .tick_source = std::move(tick_source)};
+    disp.set_event_tap(shared_from_this());
+}
+
+void EventRecorder::detach(EventDispatcher &disp) {
+    if (channels.erase(&disp) != 0 && disp.get_event_tap().get() == this)
+        disp.set_event_tap(nullptr);
+}
+
+std::uint32_t EventRecorder::get_name_index(const Event &ev) {
+    if (ev.id >= name_indices.size())
+        name_indices.resize(ev.id + 1, 0);
+
+    auto &index = name_indices[ev.id];
+    if (index == 0) {
+        EventWriter writer(recording.data);
+        writer.write(EventRecording::RecordKind::NAME);
+        writer.write_string(ev.name);
+        index = ++n_names;
+    }
+    return index - 1;
+}
+
+void EventRecorder::on_event_queued(const EventDispatcher &disp,
+                                    const Event &ev, bool front) {
+    auto iter = channels.find(&disp);
+    if (iter == channels.end())
+        return;
+
+    payload.clear();
+    const bool typed = !ev.is_a<Event>();
+    if (typed) {
+        auto codec = EventCodecRegistry::instance().find(ev.id);
+        if (!codec || !codec->accepts(ev)) {
+#ifdef DEBUG
+            std::cerr << "EventRecorder: no codec for the type of " << ev.name
+                      << ", skipping it" << std::endl;
+#endif
+            n_skipped++;
+            return;
+        }
+
+        EventWriter payload_writer(payload);
+        codec->serialize(ev, payload_writer);
+    }
+
+    auto name_index = get_name_index(ev);
+
+    EventWriter writer(recording.data);
+    writer.write(EventRecording::RecordKind::EVENT);
+    EventRecording::write_header(writer, EventRecording::EventHeader{
+        .channel = iter->second.id,
+        .front = front,
+        .typed = typed,
+        .tick = iter->second.tick_source(),
+        .name_index = name_index,
+        .size = static_cast<std::uint32_t>(payload.size()),
+    });
+    recording.data.insert(recording.data.end(), payload.begin(),
+                          payload.end());
+}
+
+const EventRecording &EventRecorder::get_recording() const {
+    return recording;
+}
+
+std::uint64_t EventRecorder::get_skipped_count() const { return n_skipped; }
+
+EventReplayer::EventReplayer(std::shared_ptr<const EventRecording> recording,
+                             std::uint8_t channel)
+    : recording(std::move(recording)), channel(channel) {}
+
+void EventReplayer::set_tick(std::uint64_t tick) { this->tick = tick; }
+
+std::size_t EventReplayer::feed_dispatcher(EventDispatcher &disp, bool) {
+    const auto data = std::span<const std::byte>(recording->data);
+    std::size_t n_fed = 0;
+
+    while (pos < data.size()) {
+        EventReader reader(data.subspan(pos));
+        auto kind = reader.read<EventRecording::RecordKind>();
+
+        if (kind == EventRecording::RecordKind::NAME) {
+            names.emplace_back(reader.read_string());
+            pos = data.size() - reader.remaining();
+            continue;
+        }
+
+        auto header = EventRecording::read_header(reader);
+        if (header.channel == channel) {
+            if (header.tick > tick)
+                break;
+
+            EventReader payload_reader(reader.read_bytes(header.size));
+            const auto &key = names.at(header.name_index);
+
+            if (!header.typed) {
+                if (header.front)
+                    disp.emplace_next<Event>(key);
+                else
+                    disp.emplace_last<Event>(key);
+                n_fed++;
+            } else if (auto codec =
+                           EventCodecRegistry::instance().find(key.get_id())) {
+                codec->replay(disp, payload_reader, header.front);
+                n_fed++;
+            } else {
+#ifdef DEBUG
+                std::cerr << "EventReplayer: no codec for " << key.get_name()
+                          << ", skipping it" << std::endl;
+#endif
+                n_skipped++;
+            }
+        } else {
+            reader.read_bytes(header.size);
+        }
+
+        pos = data.size() - reader.remaining();
+    }
+
+    return n_fed;
+}
+
+bool EventReplayer::is_finished() const {
+    return pos == recording->data.size();
+}
+
+std::uint64_t EventReplayer::get_skipped_count() const { return n_skipped; }
+
+} // namespace redseen::engine
@@ -0,0 +1,266 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "common/noncopyable.hh"
+#include "event.hh"
+#include "event_dispatcher.hh"
+#include "event_key.hh"
+#include "event_producer.hh"
+
+namespace redseen::engine {
+
+/** Appends plain values to a byte buffer. Values are stored in the native
+ * byte order. */
+class EventWriter {
+    std::vector<std::byte> &buffer;
+
+  public:
+    explicit EventWriter(std::vector<std::byte> &buffer) : buffer(buffer) {}
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    void write(const T &value) {
+        auto offset = buffer.size();
+        buffer.resize(offset + sizeof(T));
+        std::memcpy(buffer.data() + offset, &value, sizeof(T));
+    }
+
+    void write_string(const std::string_view &str);
+};
+
+/** Reads values written by EventWriter.
+Throws std::out_of_range when reading past the end. */
+class EventReader {
+    std::span<const std::byte> data;
+    std::size_t pos = 0;
+
+  public:
+    explicit EventReader(std::span<const std::byte> data) : data(data) {}
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    T read() {
+        T value;
+        std::memcpy(&value, read_bytes(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::span<const std::byte> read_bytes(std::size_t size);
+    std::string_view read_string();
+
+    std::size_t remaining() const { return data.size() - pos; }
+};
+
+/** An event type which can be recorded with its payload */
+template <class T>
+concept SerializableEvent =
+    KeyedEvent<T> && std::move_constructible<T> &&
+    requires(const T &ev, EventWriter &writer, EventReader &reader) {
+        ev.serialize(writer);
+        { T::deserialize(reader) } -> std::same_as<T>;
+    };
+
+/** Type erased serialization of an event type */
+struct EventCodec {
+    /** Whether an event of the codec's key is of its type */
+    bool (*accepts)(const Event &);
+    void (*serialize)(const Event &, EventWriter &);
+    /** Deserialize an event and queue it the way it was recorded */
+    void (*replay)(EventDispatcher &, EventReader &, bool front);
+};
+
+/** Process-wide table of event codecs by EventId.
+Plain Events don't need a codec, they're recorded by their key only. Events of
+other types without a codec can't be recorded. */
+class EventCodecRegistry {
+    std::vector<std::optional<EventCodec>> codecs;
+    mutable std::mutex mutex;
+
+    EventCodecRegistry() = default;
+
+    void add(EventId event_id, EventCodec codec);
+
+  public:
+    static EventCodecRegistry &instance();
+
+    template <SerializableEvent T> void add() {
+        add(T::event_key().get_id(),
+            EventCodec{
+                .accepts = [](const Event &ev) { return ev.is_a<T>(); },
+                .serialize =
+                    [](const Event &ev, EventWriter &writer) {
+                        static_cast<const T &>(ev).serialize(writer);
+                    },
+                .replay =
+                    [](EventDispatcher &disp, EventReader &reader, bool front) {
+                        if (front)
+                            disp.emplace_next<T>(T::deserialize(reader));
+                        else
+                            disp.emplace_last<T>(T::deserialize(reader));
+                    },
+            });
+    }
+
+    std::optional<EventCodec> find(EventId event_id) const;
+};
+
+/** Registers the codec of an event type on static initialization. Defined
+next to the event type, as an inline variable, it's registered in every
+program which can queue or observe the type:
+    inline const EventCodecRegistration<MyEvent> MY_EVENT_CODEC;
+*/
+template <SerializableEvent T> struct EventCodecRegistration {
+    EventCodecRegistration() { EventCodecRegistry::instance().add<T>(); }
+};
+
+/** Events captured from dispatchers, in a compact binary form.
+Event names are stored once, events refer to them by an index local to the
+recording, so a recording can be replayed by another process. Every event
+carries the channel it was recorded from and the tick it was queued at, counted
+from the start of the recording. */
+class EventRecording {
+  public:
+    enum class RecordKind : std::uint8_t { NAME = 0, EVENT = 1 };
+
+    /** Header of an EVENT record, followed by size bytes of payload */
+    struct EventHeader {
+        std::uint8_t channel;
+        bool front;
+        /** Whether the event was of a type with a codec, as opposed to a
+         * plain Event */
+        bool typed;
+        std::uint64_t tick;
+        std::uint32_t name_index;
+        std::uint32_t size;
+    };
+
+    static constexpr std::uint32_t FORMAT_VERSION = 3;
+
+    static void write_header(EventWriter &writer, const EventHeader &header);
+    static EventHeader read_header(EventReader &reader);
+
+    std::vector<std::byte> data;
+
+    /** Write the recording to a binary stream */
+    void save(std::ostream &out) const;
+
+    /** Read a recording saved by save().
+    Throws std::runtime_error if the stream doesn't contain a recording. */
+    static EventRecording load(std::istream &in);
+};
+
+/** Records the events entering the dispatchers it's attached to.
+Each dispatcher is recorded as a separate channel, stamped by its own tick
+source. */
+class EventRecorder : public EventTap,
+                      NonCopyable,
+                      public std::enable_shared_from_this<EventRecorder> {
+  public:
+    /** Tick the events queued now are handled in, counted from the start of
+     * the recording */
+    using TickSource = std::function<std::uint64_t()>;
+
+  private:
+    struct Channel {
+        std::uint8_t id;
+        TickSource tick_source;
+    };
+
+    EventRecording recording;
+    std::unordered_map<const EventDispatcher *, Channel> channels;
+    /** Recording's name index + 1 of EventIds, 0 if not written yet */
+    std::vector<std::uint32_t> name_indices;
+    std::uint32_t n_names = 0;
+    std::vector<std::byte> payload;
+    std::uint64_t n_skipped = 0;
+
+    EventRecorder() = default;
+
+    std::uint32_t get_name_index(const Event &ev);
+
+  public:
+    static std::shared_ptr<EventRecorder> create();
+
+    /** Start recording a dispatcher as a given channel. Replaces the
+     * dispatcher's tap. */
+    void attach(EventDispatcher &disp, std::uint8_t channel,
+                TickSource tick_source);
+
+    /** Stop recording a dispatcher */
+    void detach(EventDispatcher &disp);
+
+    void on_event_queued(const EventDispatcher &, const Event &,
+                         bool front) override;
+
+    const EventRecording &get_recording() const;
+
+    /** Number of events left out because their type has no codec */
+    std::uint64_t get_skipped_count() const;
+};
+
+/** Feeds the events of one channel of a recording back to a dispatcher.
+Each feed queues the events recorded up to the tick set by set_tick(), so
+the owner of the ticks decides where in the tick the input is handled. */
+class EventReplayer : public EventProducer {
+    std::shared_ptr<const EventRecording> recording;
+    std::uint8_t channel;
+    std::size_t pos = 0;
+    std::vector<EventKey> names;
+    std::uint64_t tick = 0;
+    std::uint64_t n_skipped = 0;
+
+  public:
+    EventReplayer(std::shared_ptr<const EventRecording> recording,
+                  std::uint8_t channel);
+
+    /** Set the tick the next feeds catch up to, counted from the start of
+     * the replay */
+    void set_tick(std::uint64_t tick);
+
+    std::size_t feed_dispatcher(EventDispatcher &, bool can_block) override;
+
+    /** Whether all the events of the channel have been fed */
+    bool is_finished() const;
+
+    /** Number of typed events left out because this program has no codec
+    for them. Replaying them as plain Events would break the observers
+    expecting the type. */
+    std::uint64_t get_skipped_count() const;
+};
+
+} // namespace redseen::engine
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "event_route_trie.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace redseen::engine {
+
+EventRouteTrie::EventRouteTrie() : nodes(1) {}
+
+bool EventRouteTrie::is_pattern(const std::string_view &name) {
+    return name.ends_with('*');
+}
+
+EventRouteTrie::Node *EventRouteTrie::find_node(const std::string_view &pattern,
+                                                bool create) {
+    if (pattern == "*")
+        return &nodes[0];
+
+    if (!pattern.ends_with(".*") || pattern.size() < 3)
+        throw std::invalid_argument("EventRouteTrie: invalid pattern " +
+                                    std::string(pattern));
+
+    auto prefix = pattern.substr(0, pattern.size() - 2);
+    std::uint32_t node = 0;
+
+    while (true) {
+        auto dot = prefix.find('.');
+        auto segment = std::string(prefix.substr(0, dot));
+
+        auto iter = nodes[node].children.find(segment);
+        if (iter != nodes[node].children.end()) {
+            node = iter->second;
+        } else if (create) {
+            auto child = static_cast<std::uint32_t>(nodes.size());
+            nodes[node].children.emplace(std::move(segment), child);
+            nodes.emplace_back();
+            node = child;
+        } else {
+            return nullptr;
+        }
+
+        if (dot == std::string_view::npos)
+            return &nodes[node];
+        prefix.remove_prefix(dot + 1);
+    }
+}
+
+void EventRouteTrie::add(const std::string_view &pattern,
+                         std::uint32_t value) {
+    find_node(pattern, true)->values.push_back(value);
+    n_values++;
+}
+
+bool EventRouteTrie::remove(const std::string_view &pattern,
+                            std::uint32_t value) {
+    auto *node = find_node(pattern, false);
+    if (node == nullptr)
+        return false;
+
+    auto iter = std::find(node->values.begin(), node->values.end(), value);
+    if (iter == node->values.end())
+        return false;
+
+    node->values.erase(iter);
+    n_values--;
+    return true;
+}
+
+void EventRouteTrie::match(const std::string_view &name,
+                           std::vector<std::uint32_t> &values) const {
+    std::uint32_t node = 0;
+    auto rest = name;
+
+    // a node matches as long as there's at least one segment left
+    while (!rest.empty()) {
+        const auto &node_values = nodes[node].values;
+        values.insert(values.end(), node_values.begin(), node_values.end());
+
+        auto dot = rest.find('.');
+        if (dot == std::string_view::npos)
+            break;
+
+        auto iter = nodes[node].children.find(std::string(rest.substr(0, dot)));
+        if (iter == nodes[node].children.end())
+            break;
+
+        node = iter->second;
+        rest.remove_prefix(dot + 1);
+    }
+}
+
+} // namespace redseen::engine
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace redseen::engine {
+
+/** Maps event name prefixes, written as patterns like "window.*", to values.
+Names are split into dot separated segments. A pattern matches the names
+starting with all of its segments and having at least one more, so
+"window.*" matches "window.key" and "window.mouse.move" but not "window".
+"*" matches every name. */
+class EventRouteTrie {
+    struct Node {
+        std::unordered_map<std::string, std::uint32_t> children;
+        std::vector<std::uint32_t> values;
+    };
+
+    std::vector<Node> nodes;
+    std::size_t n_values = 0;
+
+    /** Get the node of a pattern's prefix, optionally creating it.
+    Returns nullptr if it doesn't exist. */
+    Node *find_node(const std::string_view &pattern, bool create);
+
+  public:
+    EventRouteTrie();
+
+    /** Check whether a name is a pattern rather than an event name */
+    static bool is_pattern(const std::string_view &name);
+
+    /** Add a value under a pattern.
+    Throws std::invalid_argument if the pattern doesn't end with ".*" or
+    isn't "*". */
+    void add(const std::string_view &pattern, std::uint32_t value);
+
+    /** Remove a value added under a pattern. Returns false if it wasn't
+     * there. */
+    bool remove(const std::string_view &pattern, std::uint32_t value);
+
+    /** Append the values of the patterns matching a name, shorter prefixes
+     * first */
+    void match(const std::string_view &name,
+               std::vector<std::uint32_t> &values) const;
+
+    bool empty() const { return n_values == 0; }
+};
+
+} // namespace redseen::engine
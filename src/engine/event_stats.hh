@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "event.hh"
+#include "event_key.hh"
+
+namespace redseen::engine {
+
+/** Number of deliveries and the time they took */
+struct DispatchCounters {
+    using Duration = std::chrono::steady_clock::duration;
+
+    std::uint64_t count = 0;
+    Duration total_time{};
+    /** Longest single delivery, a batch counts as one */
+    Duration max_time{};
+
+    void add(std::uint64_t n, Duration time) {
+        count += n;
+        total_time += time;
+        max_time = std::max(max_time, time);
+    }
+};
+
+/** A snapshot of the counters of an EventDispatcher */
+struct DispatcherStats {
+    struct Entry {
+        std::string name;
+        DispatchCounters counters;
+    };
+
+    /** Per event key, only the keys which have been dispatched */
+    std::vector<Entry> events;
+    /** Per observer name, summed over all of its registrations */
+    std::vector<Entry> observers;
+    struct LaneEntry {
+        std::string name;
+        /** Events waiting in the lane */
+        std::size_t size = 0;
+        /** Time from queueing to dispatch, counted per event */
+        DispatchCounters latency;
+    };
+
+    /** Per queue lane, see EventDispatcher::add_lane */
+    std::vector<LaneEntry> lanes;
+    /** Most events waiting in the queue at once, not counting the ones
+     * posted from other threads before a dispatch moves them in */
+    std::size_t queue_high_water = 0;
+    /** Registrations freed because their observer was destroyed without
+     * unregistering */
+    std::uint64_t expired_observers = 0;
+};
+
+namespace dispatcher_events {
+inline const EventKey STATS{"dispatcher.stats"};
+} // namespace dispatcher_events
+
+/** Queued periodically by a dispatcher collecting stats, see
+ * EventDispatcher::set_stats_summary_interval */
+struct DispatcherStatsEvent : Event {
+    DispatcherStats stats;
+
+    explicit DispatcherStatsEvent(DispatcherStats stats)
+        : Event(dispatcher_events::STATS), stats(std::move(stats)) {}
+
+    static const EventKey &event_key() { return dispatcher_events::STATS; }
+};
+
+} // namespace redseen::engine
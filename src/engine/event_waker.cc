@@ -0,0 +1,79 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "event_waker.hh"
+
+namespace redseen::engine {
+
+void EventWaker::notify() {
+    signaled.store(true);
+
+    // the waiter registers itself before checking the flag, so if it's not
+    // registered yet it'll see the flag set
+    if (n_waiting.load() != 0) {
+        {
+            std::lock_guard lock(mutex);
+            if (wake_hook)
+                wake_hook();
+        }
+        cond.notify_all();
+    }
+}
+
+bool EventWaker::wait_until(Clock::time_point deadline) {
+    n_waiting++;
+    {
+        std::unique_lock lock(mutex);
+        cond.wait_until(lock, deadline, [this] { return signaled.load(); });
+    }
+    n_waiting--;
+
+    return signaled.exchange(false);
+}
+
+void EventWaker::wait() {
+    n_waiting++;
+    {
+        std::unique_lock lock(mutex);
+        cond.wait(lock, [this] { return signaled.load(); });
+    }
+    n_waiting--;
+
+    signaled.store(false);
+}
+
+bool EventWaker::begin_external_wait(std::function<void()> hook) {
+    n_waiting++;
+
+    std::lock_guard lock(mutex);
+    wake_hook = std::move(hook);
+    return !signaled.load();
+}
+
+bool EventWaker::end_external_wait() {
+    {
+        std::lock_guard lock(mutex);
+        wake_hook = nullptr;
+    }
+    n_waiting--;
+
+    return signaled.exchange(false);
+}
+
+} // namespace redseen::engine
@@ -0,0 +1,64 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace redseen::engine {
+
+/** A wake-up signal for a thread sleeping until events arrive.
+Notifying is lock-free as long as nobody is waiting. A notification sent while
+nobody waits isn't lost, the next wait returns immediately. */
+class EventWaker {
+    std::atomic<bool> signaled = false;
+    std::atomic<std::size_t> n_waiting = 0;
+    std::mutex mutex;
+    std::condition_variable cond;
+    /** Wakes a thread sleeping somewhere else than in wait() */
+    std::function<void()> wake_hook;
+
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /** Wake up the waiting thread. Safe to call from any thread. */
+    void notify();
+
+    /** Sleep until notified or until the deadline passes.
+    Returns true if woken up by a notification. */
+    bool wait_until(Clock::time_point deadline);
+
+    /** Sleep until notified */
+    void wait();
+
+    /** Make notify() call a hook while the thread sleeps outside of the
+    waker, e.g. in a window's event loop. Returns false if a notification is
+    already pending, so there's no point in sleeping. end_external_wait()
+    has to be called either way. */
+    bool begin_external_wait(std::function<void()> hook);
+
+    /** Returns true if a notification arrived during the wait */
+    bool end_external_wait();
+};
+
+} // namespace redseen::engine
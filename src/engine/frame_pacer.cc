@@ -0,0 +1,141 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "frame_pacer.hh"
+
+#include "common/profiler.hh"
+
+#include <algorithm>
+#include <thread>
+
+namespace redseen::engine {
+
+FramePacer::FramePacer(Clock::duration target_interval)
+    : target_interval(target_interval), next_frame(Clock::now()) {}
+
+void FramePacer::set_target_interval(Clock::duration interval) {
+    target_interval = std::max(interval, Clock::duration::zero());
+}
+
+FramePacer::Clock::duration FramePacer::get_target_interval() const {
+    return target_interval;
+}
+
+void FramePacer::set_target_rate(double frames_per_second) {
+    if (frames_per_second <= 0) {
+        set_target_interval({});
+        return;
+    }
+
+    set_target_interval(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / frames_per_second)));
+}
+
+void FramePacer::set_vsync_interval(Clock::duration interval) {
+    vsync_interval = std::max(interval, Clock::duration::zero());
+}
+
+FramePacer::Clock::duration FramePacer::get_frame_interval() const {
+    if (vsync_interval == Clock::duration::zero())
+        return target_interval;
+
+    // the swap can only happen on a refresh
+    auto n_refreshes = std::max<Clock::rep>(
+        (target_interval + vsync_interval - Clock::duration(1)) /
+            vsync_interval,
+        1);
+    return n_refreshes * vsync_interval;
+}
+
+void FramePacer::reset(Clock::time_point now) {
+    next_frame = now;
+    last_present = {};
+}
+
+FramePacer::Clock::time_point FramePacer::get_frame_time() const {
+    return next_frame;
+}
+
+FramePacer::Clock::time_point FramePacer::get_wake_time() const {
+    if (vsync_interval != Clock::duration::zero())
+        return next_frame;
+    return next_frame - spin_threshold;
+}
+
+bool FramePacer::is_frame_due(Clock::time_point now) const {
+    return now >= get_wake_time();
+}
+
+void FramePacer::wait_for_frame() {
+    REDSEEN_PROFILE_ZONE("FramePacer::wait_for_frame");
+    const auto interval = get_frame_interval();
+    auto now = Clock::now();
+
+    if (interval == Clock::duration::zero()) {
+        next_frame = now;
+        return;
+    }
+
+    if (vsync_interval == Clock::duration::zero()) {
+        auto wake_time = next_frame - spin_threshold;
+        if (now < wake_time) {
+            std::this_thread::sleep_until(wake_time);
+
+            auto overshoot = Clock::now() - wake_time;
+            sleep_overshoot = (sleep_overshoot * 7 + overshoot) / 8;
+            spin_threshold = std::clamp(sleep_overshoot * 2, MIN_SPIN_THRESHOLD,
+                                        MAX_SPIN_THRESHOLD);
+        }
+
+        while ((now = Clock::now()) < next_frame)
+            std::this_thread::yield();
+    }
+
+    next_frame += interval;
+    // a frame late by more than an interval doesn't make the next ones
+    // come sooner
+    if (next_frame <= now)
+        next_frame = now + interval;
+}
+
+void FramePacer::frame_presented(Clock::time_point now) {
+    const auto interval = get_frame_interval();
+    const bool has_last = last_present != Clock::time_point{};
+    const auto present_interval = now - last_present;
+    last_present = now;
+
+    if (!has_last || interval == Clock::duration::zero())
+        return;
+
+    auto error = present_interval - interval;
+    if (error < Clock::duration::zero())
+        error = -error;
+
+    stats.frames++;
+    stats.total_error += error;
+    stats.max_error = std::max(stats.max_error, error);
+    if (present_interval > interval + interval / 2)
+        stats.missed_frames++;
+}
+
+const FramePacingStats &FramePacer::get_stats() const { return stats; }
+
+void FramePacer::reset_stats() { stats = {}; }
+
+} // namespace redseen::engine
@@ -0,0 +1,110 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace redseen::engine {
+
+/** How far the frames have been from their target interval */
+struct FramePacingStats {
+    using Duration = std::chrono::steady_clock::duration;
+
+    /** Presented frames counted */
+    std::uint64_t frames = 0;
+    /** Sum and maximum of |present interval - target interval| */
+    Duration total_error{};
+    Duration max_error{};
+    /** Frames presented more than half an interval late */
+    std::uint64_t missed_frames = 0;
+
+    Duration mean_error() const {
+        return frames != 0 ? total_error / Duration::rep(frames) : Duration{};
+    }
+};
+
+/** Keeps frames at a target interval.
+The time until a frame is mostly slept, but the last part, which the OS
+timer slack could overshoot, is spun. The spun part adapts to the measured
+overshoot of the sleeps. With vsync the interval is rounded up to whole
+refresh intervals and the present does the last part of the wait. */
+class FramePacer {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr Clock::duration MIN_SPIN_THRESHOLD =
+        std::chrono::microseconds(200);
+    static constexpr Clock::duration MAX_SPIN_THRESHOLD =
+        std::chrono::milliseconds(4);
+
+  private:
+    Clock::duration target_interval;
+    Clock::duration vsync_interval{};
+    /** Time the next frame should start at */
+    Clock::time_point next_frame;
+    Clock::time_point last_present;
+    Clock::duration spin_threshold = std::chrono::milliseconds(1);
+    /** Moving average of how late the sleeps wake up */
+    Clock::duration sleep_overshoot{};
+    FramePacingStats stats;
+
+  public:
+    /** Zero means no limit */
+    explicit FramePacer(Clock::duration target_interval = {});
+
+    /** Set the interval between frames. Zero means no limit. */
+    void set_target_interval(Clock::duration interval);
+    Clock::duration get_target_interval() const;
+
+    /** Set the interval from a frame rate. 0 means no limit. */
+    void set_target_rate(double frames_per_second);
+
+    /** Set the display refresh interval times the swap interval while
+     * vsync is on, zero otherwise */
+    void set_vsync_interval(Clock::duration interval);
+
+    /** The interval frames are actually paced at */
+    Clock::duration get_frame_interval() const;
+
+    /** Start pacing from a given time, e.g. after a pause */
+    void reset(Clock::time_point now = Clock::now());
+
+    /** Time the next frame starts at */
+    Clock::time_point get_frame_time() const;
+
+    /** Time the coarse wait for the next frame should end at. What's left
+     * is up to wait_for_frame. */
+    Clock::time_point get_wake_time() const;
+
+    bool is_frame_due(Clock::time_point now) const;
+
+    /** Wait precisely until the next frame is due and schedule the one
+     * after it */
+    void wait_for_frame();
+
+    /** Count a presented frame in the stats */
+    void frame_presented(Clock::time_point now = Clock::now());
+
+    const FramePacingStats &get_stats() const;
+    void reset_stats();
+};
+
+} // namespace redseen::engine
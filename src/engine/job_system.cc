@@ -0,0 +1,338 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "job_system.hh"
+
+#include "common/profiler.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace redseen::engine {
+
+namespace {
+
+/** The worker run by the calling thread */
+struct CurrentWorker {
+    const JobSystem *system = nullptr;
+    std::ptrdiff_t index = -1;
+};
+
+thread_local CurrentWorker current;
+
+/** Shared by the jobs of a parallel_for, outlives the call if needed */
+struct ParallelFor {
+    const std::function<void(std::size_t, std::size_t)> *fn;
+    std::size_t begin;
+    std::size_t end;
+    std::size_t grain;
+    std::size_t n_chunks;
+
+    std::atomic<std::size_t> next_chunk = 0;
+    std::atomic<std::size_t> n_remaining;
+
+    std::mutex mutex;
+    std::exception_ptr exception;
+
+    void run_chunks() {
+        std::size_t i;
+        while ((i = next_chunk.fetch_add(1)) < n_chunks) {
+            auto chunk_begin = begin + i * grain;
+            auto chunk_end = std::min(chunk_begin + grain, end);
+            try {
+                (*fn)(chunk_begin, chunk_end);
+            } catch (...) {
+                std::lock_guard lock(mutex);
+                if (exception == nullptr)
+                    exception = std::current_exception();
+            }
+            n_remaining.fetch_sub(1, std::memory_order_release);
+        }
+    }
+};
+
+} // namespace
+
+std::size_t JobSystem::default_worker_count() {
+    auto n_threads = std::thread::hardware_concurrency();
+    return n_threads > 1 ? n_threads - 1 : 0;
+}
+
+JobSystem::JobSystem(std::size_t n_workers)
+    : main_thread_id(std::this_thread::get_id()) {
+    // every deque has to exist before anyone steals from it
+    workers.reserve(n_workers);
+    for (std::size_t i = 0; i < n_workers; i++)
+        workers.push_back(std::make_unique<Worker>());
+
+    for (std::size_t i = 0; i < n_workers; i++)
+        workers[i]->thread = std::thread([this, i] { worker_loop(i); });
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard lock(sleep_mutex);
+        stopping = true;
+    }
+    sleep_cond.notify_all();
+
+    for (auto &worker : workers)
+        worker->thread.join();
+}
+
+std::ptrdiff_t JobSystem::current_worker() const {
+    return current.system == this ? current.index : -1;
+}
+
+void JobSystem::worker_loop(std::size_t index) {
+    current = {.system = this, .index = std::ptrdiff_t(index)};
+    REDSEEN_PROFILE_THREAD("job worker " + std::to_string(index));
+
+    while (true) {
+        if (auto job = take_job()) {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock lock(sleep_mutex);
+        n_sleeping++;
+        sleep_cond.wait(lock, [this] { return stopping || n_queued != 0; });
+        n_sleeping--;
+        if (stopping)
+            return;
+    }
+}
+
+JobHandle JobSystem::submit(std::function<void()> fn,
+                            std::initializer_list<JobHandle> dependencies,
+                            JobAffinity affinity) {
+    return submit(std::move(fn), std::vector<JobHandle>(dependencies),
+                  affinity);
+}
+
+JobHandle JobSystem::submit(std::function<void()> fn,
+                            const std::vector<JobHandle> &dependencies,
+                            JobAffinity affinity) {
+    auto job = std::make_shared<Job>(std::move(fn), affinity);
+
+    for (const auto &dep : dependencies) {
+        if (dep == nullptr)
+            continue;
+
+        std::lock_guard lock(dep->mutex);
+        if (!dep->finished) {
+            job->n_dependencies++;
+            dep->continuations.push_back(job);
+        }
+    }
+
+    // drop the submission's own count
+    if (job->n_dependencies.fetch_sub(1) == 1)
+        schedule(job);
+    return job;
+}
+
+JobHandle JobSystem::then(const JobHandle &job, std::function<void()> fn,
+                          JobAffinity affinity) {
+    return submit(std::move(fn), {job}, affinity);
+}
+
+void JobSystem::schedule(JobHandle job) {
+    if (job->affinity == JobAffinity::MAIN_THREAD) {
+        std::lock_guard lock(main_mutex);
+        main_jobs.push_back(std::move(job));
+        return;
+    }
+
+    if (auto index = current_worker(); index >= 0) {
+        auto &worker = *workers[index];
+        std::lock_guard lock(worker.mutex);
+        worker.jobs.push_back(std::move(job));
+    } else {
+        std::lock_guard lock(shared_mutex);
+        shared_jobs.push_back(std::move(job));
+    }
+
+    // a worker about to sleep either sees the count or gets notified
+    n_queued++;
+    if (n_sleeping != 0) {
+        std::lock_guard lock(sleep_mutex);
+        sleep_cond.notify_one();
+    }
+}
+
+JobHandle JobSystem::take_job() {
+    JobHandle job;
+    auto index = current_worker();
+
+    auto take = [&](std::mutex &mutex, std::deque<JobHandle> &jobs,
+                    bool newest) {
+        std::lock_guard lock(mutex);
+        if (jobs.empty())
+            return false;
+
+        if (newest) {
+            job = std::move(jobs.back());
+            jobs.pop_back();
+        } else {
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        n_queued--;
+        return true;
+    };
+
+    if (index >= 0 && take(workers[index]->mutex, workers[index]->jobs, true))
+        return job;
+    if (take(shared_mutex, shared_jobs, false))
+        return job;
+
+    const auto n_workers = workers.size();
+    const auto first = index >= 0 ? std::size_t(index) + 1 : 0;
+    for (std::size_t i = 0; i < n_workers; i++) {
+        auto &victim = *workers[(first + i) % n_workers];
+        if (take(victim.mutex, victim.jobs, false))
+            return job;
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(const JobHandle &job) {
+    try {
+        job->fn();
+    } catch (...) {
+        job->exception = std::current_exception();
+    }
+    // free the captures early
+    job->fn = nullptr;
+
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard lock(job->mutex);
+        job->finished = true;
+        continuations.swap(job->continuations);
+    }
+    job->done.store(true, std::memory_order_release);
+
+    // continuations run even if the job has thrown
+    for (auto &next : continuations) {
+        if (next->n_dependencies.fetch_sub(1) == 1)
+            schedule(std::move(next));
+    }
+}
+
+bool JobSystem::try_run_one() {
+    if (std::this_thread::get_id() == main_thread_id) {
+        JobHandle job;
+        {
+            std::lock_guard lock(main_mutex);
+            if (!main_jobs.empty()) {
+                job = std::move(main_jobs.front());
+                main_jobs.pop_front();
+            }
+        }
+        if (job) {
+            execute(job);
+            return true;
+        }
+    }
+
+    if (auto job = take_job()) {
+        execute(job);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::wait(const JobHandle &job) {
+    while (!job->is_done()) {
+        if (!try_run_one())
+            std::this_thread::yield();
+    }
+
+    if (job->exception)
+        std::rethrow_exception(job->exception);
+}
+
+void JobSystem::parallel_for(
+    std::size_t begin, std::size_t end, std::size_t grain,
+    const std::function<void(std::size_t, std::size_t)> &fn) {
+    if (end <= begin)
+        return;
+
+    grain = std::max<std::size_t>(grain, 1);
+    const auto n_chunks = (end - begin + grain - 1) / grain;
+
+    if (workers.empty() || n_chunks == 1) {
+        for (auto i = begin; i < end; i += grain)
+            fn(i, std::min(i + grain, end));
+        return;
+    }
+
+    auto state = std::make_shared<ParallelFor>();
+    state->fn = &fn;
+    state->begin = begin;
+    state->end = end;
+    state->grain = grain;
+    state->n_chunks = n_chunks;
+    state->n_remaining = n_chunks;
+
+    // helpers coming late find no chunks left and only touch the state
+    const auto n_helpers = std::min(n_chunks - 1, workers.size());
+    for (std::size_t i = 0; i < n_helpers; i++)
+        submit([state] { state->run_chunks(); });
+
+    state->run_chunks();
+
+    // only chunks being run by others are left, so there's no point in
+    // picking up unrelated jobs
+    while (state->n_remaining.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+
+    if (state->exception)
+        std::rethrow_exception(state->exception);
+}
+
+std::size_t JobSystem::run_main_thread_jobs() {
+    if (std::this_thread::get_id() != main_thread_id)
+        throw std::logic_error("Main thread jobs run on another thread");
+
+    std::deque<JobHandle> jobs;
+    {
+        std::lock_guard lock(main_mutex);
+        jobs.swap(main_jobs);
+    }
+
+    // jobs queued by these ones wait for the next call
+    for (const auto &job : jobs)
+        execute(job);
+    return jobs.size();
+}
+
+void JobSystem::run(std::size_t n,
+                    const std::function<void(std::size_t)> &fn) {
+    parallel_for(0, n, 1, [&fn](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++)
+            fn(i);
+    });
+}
+
+std::size_t JobSystem::get_worker_count() const { return workers.size(); }
+
+} // namespace redseen::engine
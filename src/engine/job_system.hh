@@ -0,0 +1,157 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common/noncopyable.hh"
+#include "event_dispatcher.hh"
+
+namespace redseen::engine {
+
+class JobSystem;
+
+/** Where a job may run */
+enum class JobAffinity {
+    /** Any worker, or a thread waiting for jobs */
+    ANY,
+    /** Only the main thread, from JobSystem::run_main_thread_jobs or while
+     * it waits. Meant for GL work. */
+    MAIN_THREAD,
+};
+
+/** A unit of work of a JobSystem. Jobs are referred to by JobHandles. */
+class Job : NonCopyable {
+    std::function<void()> fn;
+    JobAffinity affinity;
+
+    /** Unfinished dependencies, plus one while the job is being submitted */
+    std::atomic<std::size_t> n_dependencies = 1;
+    std::atomic<bool> done = false;
+    std::exception_ptr exception;
+
+    std::mutex mutex;
+    /** Jobs waiting for this one, scheduled once it's finished */
+    std::vector<std::shared_ptr<Job>> continuations;
+    bool finished = false;
+
+    friend class JobSystem;
+
+  public:
+    Job(std::function<void()> fn, JobAffinity affinity)
+        : fn(std::move(fn)), affinity(affinity) {}
+
+    bool is_done() const { return done.load(std::memory_order_acquire); }
+};
+
+using JobHandle = std::shared_ptr<Job>;
+
+/** A pool of worker threads sharing jobs by work stealing.
+Every worker has a deque of its own: it takes the newest job from its back
+and, once empty, steals the oldest jobs from the others. Jobs submitted from
+other threads go to a shared queue. Threads waiting for a job run other jobs
+meanwhile, so waiting inside a job doesn't block a worker. */
+class JobSystem : public ObserverExecutor, NonCopyable {
+    struct Worker {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex shared_mutex;
+    std::deque<JobHandle> shared_jobs;
+
+    std::mutex main_mutex;
+    std::deque<JobHandle> main_jobs;
+    std::thread::id main_thread_id;
+
+    /** Jobs in the worker and shared queues */
+    std::atomic<std::size_t> n_queued = 0;
+    std::atomic<std::size_t> n_sleeping = 0;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cond;
+    bool stopping = false;
+
+    /** Index of the worker run by the calling thread, or -1 */
+    std::ptrdiff_t current_worker() const;
+
+    void worker_loop(std::size_t index);
+
+    /** Queue a job whose dependencies are done */
+    void schedule(JobHandle job);
+    /** Take a job from the calling thread's queues or steal one */
+    JobHandle take_job();
+    /** Run a job and schedule its continuations */
+    void execute(const JobHandle &job);
+    /** Run a single queued job if there's one */
+    bool try_run_one();
+
+  public:
+    /** One worker per hardware thread besides the main one */
+    static std::size_t default_worker_count();
+
+    /** The calling thread becomes the main thread */
+    explicit JobSystem(std::size_t n_workers = default_worker_count());
+    ~JobSystem();
+
+    /** Submit a job which runs once all of its dependencies are done */
+    JobHandle submit(std::function<void()> fn,
+                     std::initializer_list<JobHandle> dependencies = {},
+                     JobAffinity affinity = JobAffinity::ANY);
+    JobHandle submit(std::function<void()> fn,
+                     const std::vector<JobHandle> &dependencies,
+                     JobAffinity affinity = JobAffinity::ANY);
+
+    /** Submit a job running after another one */
+    JobHandle then(const JobHandle &job, std::function<void()> fn,
+                   JobAffinity affinity = JobAffinity::ANY);
+
+    /** Wait for a job, running other jobs meanwhile. Rethrows what the job
+     * has thrown. */
+    void wait(const JobHandle &job);
+
+    /** Call fn(begin, end) for consecutive subranges of [begin, end) of at
+    most grain indices, in parallel, and return once all are done. The
+    calling thread takes part. Rethrows the first exception thrown. */
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+                      const std::function<void(std::size_t, std::size_t)> &fn);
+
+    /** Run the jobs queued for the main thread. Main thread only.
+    Returns the number of jobs run. */
+    std::size_t run_main_thread_jobs();
+
+    void run(std::size_t n, const std::function<void(std::size_t)> &fn) override;
+
+    std::size_t get_worker_count() const;
+};
+
+} // namespace redseen::engine
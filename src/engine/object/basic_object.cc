@@ -32,6 +32,7 @@
 #include "engine/model.hh"
 #include "engine/geometry.hh"
 #include "engine/object/object.hh"
+#include "engine/render_state.hh"
 #include "engine/renderer.hh"
 #include "render/model.hh"
 
@@ -39,7 +40,8 @@ namespace redseen::engine {
 
 BasicObject::BasicObject(const glm::mat4 &transform,
                          std::shared_ptr<const Model> model)
-    : transform(transform), model(std::move(model)) {}
+    : transform(transform), previous_transform(transform),
+      model(std::move(model)) {}
 
 BasicObject::BasicObject(const Position3f &pos,
                          std::shared_ptr<const Model> model)
@@ -57,6 +59,17 @@ void BasicObject::set_transform(const glm::mat4 &transform) {
     this->transform = transform;
 }
 
+void BasicObject::snap_transform(const glm::mat4 &transform) {
+    this->transform = transform;
+    previous_transform = transform;
+}
+
+glm::mat4 BasicObject::get_interpolated_transform(float alpha) const {
+    auto tr = transform;
+    tr[3] = glm::mix(previous_transform[3], transform[3], alpha);
+    return tr;
+}
+
 Position3f BasicObject::get_pos() const { return transform[3]; }
 
 void BasicObject::set_pos(const Position3f &pos) {
@@ -64,10 +77,17 @@ void BasicObject::set_pos(const Position3f &pos) {
     this->transform[3] = glm::vec4(pos, tr[3][3]);
 }
 
+void BasicObject::snap_pos(const Position3f &pos) {
+    set_pos(pos);
+    previous_transform = transform;
+}
+
 ObjectUpdateResult BasicObject::update(Engine &engine) {
     return ObjectUpdateResult::NORMAL;
 }
 
+void BasicObject::begin_tick() { previous_transform = transform; }
+
 bool BasicObject::render(Engine &engine, const glm::vec3 &lightPos) {
 #ifdef DEBUG
     std::cerr << "Rendering "
@@ -75,7 +95,18 @@ bool BasicObject::render(Engine &engine, const glm::vec3 &lightPos) {
               << std::endl;
 #endif
     return engine.get_renderer()->render(
-        {*get_model(), get_transform(), lightPos});
+        {*get_model(),
+         get_interpolated_transform(engine.get_interpolation_alpha()),
+         lightPos});
+}
+
+bool BasicObject::extract(Engine &, RenderState &state) const {
+    if (model == nullptr)
+        return false;
+
+    state.items.push_back(
+        {model, get_interpolated_transform(state.interpolation_alpha)});
+    return true;
 }
 
 } // namespace redseen::engine
\ No newline at end of file
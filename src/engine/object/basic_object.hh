@@ -31,6 +31,8 @@ class Engine;
 /** External objects should derive from this class */
 class BasicObject : public Object {
     glm::mat4 transform;
+    /** Transform at the start of the last tick */
+    glm::mat4 previous_transform;
     std::shared_ptr<const Model> model;
 
   public:
@@ -41,13 +43,26 @@ class BasicObject : public Object {
     void set_model(std::shared_ptr<const Model> model);
 
     glm::mat4 get_transform() const;
+    /** Move the object, the frames interpolate from where it was at the
+     * start of the tick */
     void set_transform(const glm::mat4 &transform);
+    /** Move the object without interpolating, e.g. to place it outside
+     * a tick or to teleport it */
+    void snap_transform(const glm::mat4 &transform);
+
+    /** Transform between the previous and the current one. Only the
+     * position is interpolated. */
+    glm::mat4 get_interpolated_transform(float alpha) const;
 
     Position3f get_pos() const override;
     void set_pos(const Position3f &pos) override;
+    /** Like set_pos, but without interpolating, see snap_transform */
+    void snap_pos(const Position3f &pos);
 
     ObjectUpdateResult update(Engine &) override;
+    void begin_tick() override;
     bool render(Engine &, const glm::vec3 &lightPos) override;
+    bool extract(Engine &, RenderState &) const override;
 };
 
 } // namespace redseen::engine
\ No newline at end of file
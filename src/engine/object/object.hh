@@ -27,6 +27,7 @@
 namespace redseen::engine {
 
 class Engine;
+struct RenderState;
 
 enum class ObjectUpdateResult {
     /** Normal update */
@@ -46,9 +47,19 @@ class Object {
     Called by the ObjectManager on each TICK */
     virtual ObjectUpdateResult update(Engine &) = 0;
 
+    /** Keep the state the object is going to be interpolated from while
+    rendering, see Engine::get_interpolation_alpha. Called by the
+    ObjectManager right before update. */
+    virtual void begin_tick() {}
+
     /** Render the object. Called by Renderer. */
     virtual bool render(Engine &, const glm::vec3 &lightPos) = 0;
 
+    /** Add what's needed to draw the object to a render state, for the
+    pipelined frames (see Engine::set_pipelined_frames). Returns false if the
+    object doesn't support it, such objects aren't drawn then. */
+    virtual bool extract(Engine &, RenderState &) const { return false; }
+
     friend class ObjectManager;
 };
 } // namespace redseen::engine
\ No newline at end of file
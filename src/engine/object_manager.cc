@@ -27,6 +27,7 @@
 #include "object/object.hh"
 #include "engine/event_observer.hh"
 #include "engine/engine.hh"
+#include "common/profiler.hh"
 
 #include <string_view>
 
@@ -50,8 +51,8 @@ ObserverReturnSignal ObjectManager::on_event(const Event &event) {
 
     update();
 
-    engine->get_internal_event_dispatcher()->queue_next(
-        std::make_shared<Event>(engine_events::OBJECT_UPDATE_DONE));
+    engine->get_internal_event_dispatcher()->emplace_next<Event>(
+        engine_events::OBJECT_UPDATE_DONE);
 
     return ObserverReturnSignal::CONTINUE;
 }
@@ -66,7 +67,11 @@ void ObjectManager::update() {
 #ifdef DEBUG
     std::cerr << "ObjetManager: update()" << std::endl;
 #endif
+    REDSEEN_PROFILE_ZONE("ObjectManager::update");
+    REDSEEN_PROFILE_COUNTER("objects", obj_map.size());
+
     for (const auto &object_pair : obj_map) {
+        object_pair.second->begin_tick();
         ObjectUpdateResult result = object_pair.second->update(*engine);
         switch (result) {
         case ObjectUpdateResult::DESTROY:
@@ -77,6 +82,12 @@ void ObjectManager::update() {
     }
 }
 
+void ObjectManager::extract(RenderState &state) const {
+    REDSEEN_PROFILE_ZONE("ObjectManager::extract");
+    for (const auto &object_pair : obj_map)
+        object_pair.second->extract(*engine, state);
+}
+
 void ObjectManager::subscribe_dispatcher(std::weak_ptr<ObjectManager> _this,
                                          EventDispatcher &disp) {
 #if 0
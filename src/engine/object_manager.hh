@@ -34,6 +34,7 @@ namespace redseen::engine {
 
 class Engine;
 class Object;
+struct RenderState;
 
 /** Class encapsulating object creation */
 class ObjectManager : public EventObserver {
@@ -74,6 +75,8 @@ class ObjectManager : public EventObserver {
 
   protected:
     void update();
+    /** Extract the render state of all objects */
+    void extract(RenderState &state) const;
 
   private:
     bool add_object(const std::string_view &key,
@@ -0,0 +1,46 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace redseen::engine {
+
+class Model;
+
+/** What the Renderer needs from the objects to draw a frame, extracted so
+that the simulation can go on while the frame is being drawn */
+struct RenderState {
+    struct Item {
+        std::shared_ptr<const Model> model;
+        glm::mat4 transform;
+    };
+
+    std::vector<Item> items;
+    /** Interpolation alpha the transforms have been extracted with */
+    float interpolation_alpha = 1.f;
+
+    void clear() { items.clear(); }
+};
+
+} // namespace redseen::engine
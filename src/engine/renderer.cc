@@ -24,6 +24,8 @@
 #include "engine/event_observer.hh"
 #include "engine/object/object.hh"
 #include "model.hh"
+#include "common/profiler.hh"
+#include "render_state.hh"
 
 namespace redseen::engine {
 
@@ -51,12 +53,10 @@ ObserverReturnSignal Renderer::on_event(const Event &ev) {
     auto &int_disp = *engine->get_internal_event_dispatcher();
     if (ev.has_name(engine_events::UPDATE)) {
         update();
-        int_disp.queue_next(
-            std::make_unique<Event>(engine_events::RENDER_UPDATE_DONE));
+        int_disp.emplace_next<Event>(engine_events::RENDER_UPDATE_DONE);
     } else if (ev.has_name(engine_events::RENDER)) {
         render();
-        int_disp.queue_next(
-            std::make_unique<Event>(engine_events::RENDER_DONE));
+        int_disp.emplace_next<Event>(engine_events::RENDER_DONE);
     } else if (ev.has_name(engine_events::PRESENT)) {
         present();
     }
@@ -65,6 +65,7 @@ ObserverReturnSignal Renderer::on_event(const Event &ev) {
 }
 
 void Renderer::render() {
+    REDSEEN_PROFILE_ZONE("Renderer::render");
     auto &om = *engine->get_object_manager();
     auto [obj_beg, obj_end] = om.get_objects();
 
@@ -80,4 +81,13 @@ void Renderer::render() {
     }
 }
 
+void Renderer::render(const RenderState &state) {
+    REDSEEN_PROFILE_ZONE("Renderer::render");
+    REDSEEN_PROFILE_COUNTER("render items", state.items.size());
+    auto camera_pos = engine->get_player_camera().getPosition();
+
+    for (const auto &item : state.items)
+        render({*item.model, item.transform, camera_pos});
+}
+
 } // namespace redseen::engine
\ No newline at end of file
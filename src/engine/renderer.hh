@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <exception>
 #include <memory>
 
@@ -33,6 +34,7 @@ namespace redseen::engine {
 
 class Model;
 class Engine;
+struct RenderState;
 class Event;
 class EventDispatcher;
 
@@ -60,6 +62,14 @@ class Renderer : public EventObserver {
 
     virtual void init() = 0;
 
+    /** Make present() wait for a number of display refreshes, 0 disables
+     * vsync. Does nothing if the renderer has no control over it. */
+    virtual void set_swap_interval(int) {}
+    /** Refresh interval of the display, zero if unknown */
+    virtual std::chrono::nanoseconds get_refresh_interval() const {
+        return {};
+    }
+
     bool render(const RenderRequest &);
     ObserverReturnSignal on_event(const Event &) override;
     struct IncompatibleRendererError : public std::logic_error {
@@ -74,6 +84,8 @@ class Renderer : public EventObserver {
     /** By default Renderer iterates over all objects
     and renders them */
     virtual void render();
+    /** Render an extracted state instead of the objects themselves */
+    virtual void render(const RenderState &);
     virtual void present() = 0;
 
     friend class Engine;
@@ -44,6 +44,19 @@ void OpenGLRenderer::update() { ogl_drawer->clear(0, 0, 0); }
 
 void OpenGLRenderer::present() { ogl_drawer->present(); }
 
+void OpenGLRenderer::set_swap_interval(int interval) {
+    ogl_drawer->setSwapInterval(interval);
+}
+
+std::chrono::nanoseconds OpenGLRenderer::get_refresh_interval() const {
+    auto rate = ogl_drawer->getRefreshRate();
+    if (rate <= 0)
+        return {};
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(1.0 / rate));
+}
+
 bool OpenGLRenderer::render(const render::Model &model,
                             const glm::mat4 &transform,
                             const glm::vec3 &lightPos) {
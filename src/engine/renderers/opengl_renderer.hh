@@ -50,6 +50,9 @@ class OpenGLRenderer : public engine::Renderer {
     void update() override;
     void present() override;
 
+    void set_swap_interval(int interval) override;
+    std::chrono::nanoseconds get_refresh_interval() const override;
+
     bool render(const render::Model &, const glm::mat4 &transform,
                 const glm::vec3 &lightPos);
 
@@ -0,0 +1,244 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "timer_wheel.hh"
+
+#include <algorithm>
+
+#include "event_dispatcher.hh"
+
+namespace redseen::engine {
+
+static constexpr std::uint64_t level_span(std::size_t level) {
+    return std::uint64_t(1) << (TimerWheel::SLOT_BITS * level);
+}
+
+TimerWheel::TimerWheel(Clock::duration resolution)
+    : resolution(resolution), start_time(Clock::now()) {
+    slots.fill(NO_TIMER);
+}
+
+std::uint64_t TimerWheel::to_ticks(Clock::duration duration) const {
+    if (duration <= Clock::duration::zero())
+        return 1;
+    // round up so timers never fire early
+    return std::max<std::uint64_t>(
+        (duration.count() + resolution.count() - 1) / resolution.count(), 1);
+}
+
+std::uint32_t TimerWheel::allocate_timer() {
+    if (free_timers != NO_TIMER) {
+        auto index = free_timers;
+        free_timers = timers[index].next;
+        return index;
+    }
+
+    timers.emplace_back();
+    return static_cast<std::uint32_t>(timers.size() - 1);
+}
+
+void TimerWheel::free_timer(std::uint32_t index) {
+    auto &timer = timers[index];
+    timer.event.reset();
+    timer.used = false;
+    timer.generation++;
+    timer.prev = NO_TIMER;
+    timer.next = free_timers;
+    free_timers = index;
+    n_pending--;
+}
+
+void TimerWheel::link_timer(std::uint32_t index) {
+    auto &timer = timers[index];
+    auto delta = timer.expiry - current_tick;
+    auto at = timer.expiry;
+
+    std::size_t level = 0;
+    while (level < N_LEVELS - 1 && delta >= level_span(level + 1))
+        level++;
+
+    // beyond the range of the wheel, revisit it once the last level
+    // cascades
+    if (delta >= level_span(N_LEVELS))
+        at = current_tick + level_span(N_LEVELS) - 1;
+
+    timer.slot = static_cast<std::uint32_t>(
+        level * N_SLOTS + ((at >> (SLOT_BITS * level)) & (N_SLOTS - 1)));
+    timer.prev = NO_TIMER;
+    timer.next = slots[timer.slot];
+    if (timer.next != NO_TIMER)
+        timers[timer.next].prev = index;
+    slots[timer.slot] = index;
+}
+
+void TimerWheel::unlink_timer(std::uint32_t index) {
+    auto &timer = timers[index];
+    if (timer.prev != NO_TIMER)
+        timers[timer.prev].next = timer.next;
+    else
+        slots[timer.slot] = timer.next;
+
+    if (timer.next != NO_TIMER)
+        timers[timer.next].prev = timer.prev;
+}
+
+std::uint32_t TimerWheel::take_slot(std::size_t slot) {
+    auto head = slots[slot];
+    slots[slot] = NO_TIMER;
+    return head;
+}
+
+void TimerWheel::cascade(std::size_t level) {
+    auto slot = level * N_SLOTS +
+                ((current_tick >> (SLOT_BITS * level)) & (N_SLOTS - 1));
+
+    for (auto index = take_slot(slot); index != NO_TIMER;) {
+        auto next = timers[index].next;
+        link_timer(index);
+        index = next;
+    }
+}
+
+std::size_t TimerWheel::step(EventDispatcher &disp) {
+    current_tick++;
+
+    // coarser levels first, so their timers can land in a slot of a finer
+    // level which is cascaded at the same tick
+    for (std::size_t level = N_LEVELS - 1; level > 0; level--) {
+        if ((current_tick & (level_span(level) - 1)) == 0)
+            cascade(level);
+    }
+
+    std::size_t n_fired = 0;
+    for (auto index = take_slot(current_tick & (N_SLOTS - 1));
+         index != NO_TIMER;) {
+        auto &timer = timers[index];
+        auto next = timer.next;
+
+        if (timer.period != 0) {
+            disp.queue_last(timer.event);
+            timer.expiry += timer.period;
+            link_timer(index);
+        } else {
+            disp.queue_last(std::move(timer.event));
+            free_timer(index);
+        }
+
+        n_fired++;
+        index = next;
+    }
+    return n_fired;
+}
+
+TimerHandle TimerWheel::schedule(std::uint64_t delay, std::uint64_t period,
+                                 std::shared_ptr<Event> event) {
+    auto index = allocate_timer();
+    auto &timer = timers[index];
+    timer.event = std::move(event);
+    timer.expiry = current_tick + delay;
+    timer.period = period;
+    timer.used = true;
+    link_timer(index);
+    n_pending++;
+
+    return TimerHandle{.index = index, .generation = timer.generation};
+}
+
+TimerHandle TimerWheel::schedule_after(Clock::duration delay,
+                                       std::shared_ptr<Event> event) {
+    return schedule(to_ticks(delay), 0, std::move(event));
+}
+
+TimerHandle TimerWheel::schedule_every(Clock::duration period,
+                                       std::shared_ptr<Event> event) {
+    auto ticks = to_ticks(period);
+    return schedule(ticks, ticks, std::move(event));
+}
+
+bool TimerWheel::cancel(TimerHandle handle) {
+    if (!is_scheduled(handle))
+        return false;
+
+    unlink_timer(handle.index);
+    free_timer(handle.index);
+    return true;
+}
+
+bool TimerWheel::is_scheduled(TimerHandle handle) const {
+    return handle.index < timers.size() && timers[handle.index].used &&
+           timers[handle.index].generation == handle.generation;
+}
+
+std::size_t TimerWheel::get_pending_count() const { return n_pending; }
+
+std::size_t TimerWheel::advance(EventDispatcher &disp, std::uint64_t n_ticks) {
+    std::size_t n_fired = 0;
+
+    for (; n_ticks != 0; n_ticks--) {
+        // nothing to cascade or fire, jump straight to the target
+        if (n_pending == 0) {
+            current_tick += n_ticks;
+            break;
+        }
+        n_fired += step(disp);
+    }
+    return n_fired;
+}
+
+std::size_t TimerWheel::advance_time(EventDispatcher &disp,
+                                     Clock::duration elapsed) {
+    carried_time += elapsed;
+    auto n_ticks = static_cast<std::uint64_t>(carried_time / resolution);
+    carried_time %= resolution;
+    return advance(disp, n_ticks);
+}
+
+TimerWheel::Clock::time_point TimerWheel::next_deadline() const {
+    if (n_pending == 0)
+        return Clock::time_point::max();
+
+    auto next_tick = std::numeric_limits<std::uint64_t>::max();
+
+    for (std::size_t level = 0; level < N_LEVELS; level++) {
+        // slots of a level are visited every level_span(level) ticks
+        const auto base = current_tick >> (SLOT_BITS * level);
+
+        for (std::uint64_t k = 1; k <= N_SLOTS; k++) {
+            auto slot = level * N_SLOTS + ((base + k) & (N_SLOTS - 1));
+            if (slots[slot] != NO_TIMER) {
+                next_tick = std::min(next_tick,
+                                     (base + k) << (SLOT_BITS * level));
+                break;
+            }
+        }
+    }
+
+    return start_time + resolution * next_tick;
+}
+
+std::size_t TimerWheel::feed_dispatcher(EventDispatcher &disp, bool) {
+    auto target = static_cast<std::uint64_t>((Clock::now() - start_time) /
+                                             resolution);
+    if (target <= current_tick)
+        return 0;
+
+    return advance(disp, target - current_tick);
+}
+
+} // namespace redseen::engine
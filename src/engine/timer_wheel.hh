@@ -0,0 +1,149 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "common/noncopyable.hh"
+#include "event.hh"
+#include "event_producer.hh"
+
+namespace redseen::engine {
+
+/** Identifies a scheduled timer. Handles of fired or cancelled timers are
+ * never reused for other timers. */
+struct TimerHandle {
+    static constexpr std::uint32_t INVALID_INDEX =
+        std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t index = INVALID_INDEX;
+    std::uint32_t generation = 0;
+
+    bool is_valid() const { return index != INVALID_INDEX; }
+    bool operator==(const TimerHandle &) const = default;
+};
+
+/** Queues events after a delay or periodically.
+Timers live in a hierarchical timing wheel: 4 levels of 256 slots, each level
+256 times coarser than the previous one. Scheduling and cancelling is O(1),
+a timer moves down a level at most 3 times before firing, so pending timers
+cost nothing until they're due. Time is counted in ticks of a given
+resolution, delays are rounded up to whole ticks.
+Must only be used from the thread feeding the dispatcher. */
+class TimerWheel : public EventProducer, NonCopyable {
+  public:
+    static constexpr std::size_t N_LEVELS = 4;
+    static constexpr std::size_t SLOT_BITS = 8;
+    static constexpr std::size_t N_SLOTS = 1 << SLOT_BITS;
+    static constexpr Clock::duration DEFAULT_RESOLUTION =
+        std::chrono::milliseconds(1);
+
+  private:
+    static constexpr std::uint32_t NO_TIMER =
+        std::numeric_limits<std::uint32_t>::max();
+
+    struct Timer {
+        std::shared_ptr<Event> event;
+        std::uint64_t expiry = 0;
+        /** Ticks between firings, 0 for one-shot timers */
+        std::uint64_t period = 0;
+        std::uint32_t generation = 0;
+        /** Links of the slot list, or the free list for unused timers */
+        std::uint32_t prev = NO_TIMER;
+        std::uint32_t next = NO_TIMER;
+        std::uint32_t slot = 0;
+        bool used = false;
+    };
+
+    std::vector<Timer> timers;
+    std::uint32_t free_timers = NO_TIMER;
+    std::array<std::uint32_t, N_LEVELS * N_SLOTS> slots;
+    std::size_t n_pending = 0;
+
+    Clock::duration resolution;
+    Clock::time_point start_time;
+    std::uint64_t current_tick = 0;
+    /** Time passed to advance_time() short of a whole tick */
+    Clock::duration carried_time{};
+
+    std::uint64_t to_ticks(Clock::duration duration) const;
+
+    std::uint32_t allocate_timer();
+    void free_timer(std::uint32_t index);
+
+    /** Put a timer into the slot its expiry falls into */
+    void link_timer(std::uint32_t index);
+    void unlink_timer(std::uint32_t index);
+
+    /** Detach the whole list of a slot */
+    std::uint32_t take_slot(std::size_t slot);
+
+    /** Move the timers of a slot to the finer levels */
+    void cascade(std::size_t level);
+
+    /** Move time forward by one tick, queueing the due events */
+    std::size_t step(EventDispatcher &disp);
+
+    TimerHandle schedule(std::uint64_t delay, std::uint64_t period,
+                         std::shared_ptr<Event> event);
+
+  public:
+    explicit TimerWheel(Clock::duration resolution = DEFAULT_RESOLUTION);
+
+    /** Queue an event once after a delay */
+    TimerHandle schedule_after(Clock::duration delay,
+                               std::shared_ptr<Event> event);
+
+    /** Queue an event each period, starting one period from now. The same
+     * event object is queued every time. */
+    TimerHandle schedule_every(Clock::duration period,
+                               std::shared_ptr<Event> event);
+
+    /** Cancel a timer. Returns false if it has already fired or has been
+     * cancelled. */
+    bool cancel(TimerHandle handle);
+
+    bool is_scheduled(TimerHandle handle) const;
+
+    std::size_t get_pending_count() const;
+
+    /** Move time forward by a number of ticks, queueing the due events.
+    feed_dispatcher() does this based on the clock. */
+    std::size_t advance(EventDispatcher &disp, std::uint64_t n_ticks);
+
+    /** Move time forward by a duration, e.g. a simulation step, for wheels
+    driven by their owner instead of being fed as a producer. What's short of
+    a whole tick is carried over to the next call. */
+    std::size_t advance_time(EventDispatcher &disp, Clock::duration elapsed);
+
+    std::size_t feed_dispatcher(EventDispatcher &disp, bool can_block) override;
+
+    /** Time of the next tick something happens at: a timer fires or a
+     * coarser slot has to be cascaded */
+    Clock::time_point next_deadline() const override;
+};
+
+} // namespace redseen::engine
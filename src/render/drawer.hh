@@ -27,6 +27,11 @@ class Drawer {
 
     virtual void clear(float r, float g, float b, float a = 1.0f) = 0;
     virtual void present() = 0;
+
+    /** Number of display refreshes present() waits for, 0 disables vsync */
+    virtual void setSwapInterval(int) {}
+    /** Refresh rate of the display in Hz, 0 if unknown */
+    virtual double getRefreshRate() const { return 0.0; }
 };
 
 } // namespace redseen::render
@@ -21,6 +21,7 @@
 #include "opengl_mesh_handle.hh"
 #include "mesh_shaders.hh"
 #include "shader.hh"
+#include "common/profiler.hh"
 #include <glad/glad.h>
 
 namespace redseen::render {
@@ -37,6 +38,7 @@ void MeshRenderer::render(const OpenGLMeshHandle &mesh,
                           const glm::mat4 &projection, const glm::mat4 &model,
                           const glm::vec3 &color, unsigned int textureID,
                           const glm::vec3 &lightPosition) {
+    REDSEEN_PROFILE_ZONE("MeshRenderer::render");
     // TODO: Expand lightning implementation
 
     shader->use();
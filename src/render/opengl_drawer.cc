@@ -182,6 +182,23 @@ void OpenGLDrawer::drawTexture(GLuint texture, int x, int y, int width,
 
 void OpenGLDrawer::present() { glfwSwapBuffers(m_window); }
 
+void OpenGLDrawer::setSwapInterval(int interval) {
+    // applies to the current context
+    glfwSwapInterval(interval);
+}
+
+double OpenGLDrawer::getRefreshRate() const {
+    // a windowed window has no monitor of its own
+    GLFWmonitor *monitor = glfwGetWindowMonitor(m_window);
+    if (monitor == nullptr)
+        monitor = glfwGetPrimaryMonitor();
+    if (monitor == nullptr)
+        return 0.0;
+
+    const GLFWvidmode *mode = glfwGetVideoMode(monitor);
+    return mode != nullptr ? mode->refreshRate : 0.0;
+}
+
 void *OpenGLDrawer::getWindowHandle() const { return m_window; }
 
 } // namespace redseen::render
@@ -36,6 +36,8 @@ class OpenGLDrawer : public Drawer {
     virtual void drawTexture(unsigned int texture, int x, int y, int width,
                              int height);
     void present() override;
+    void setSwapInterval(int interval) override;
+    double getRefreshRate() const override;
     void *getWindowHandle() const;
 
   private:
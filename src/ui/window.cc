@@ -23,6 +23,9 @@
 #include <endian.h>
 #include <stdexcept>
 #include <chrono>
+#ifdef DEBUG
+#include <iostream>
+#endif
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -50,92 +53,151 @@ std::size_t Window::feed_dispatcher(engine::EventDispatcher &disp,
     return impl->feed_dispatcher(disp, can_block);
 }
 
+bool Window::can_wait() const { return true; }
+
+std::size_t Window::wait_until(engine::EventDispatcher &disp,
+                               Clock::time_point deadline) {
+    return impl->wait_until(disp, deadline);
+}
+
+void Window::wake() { impl->wake(); }
+
 void WindowImpl::init_callbacks() {
     glfwSetWindowUserPointer(window, this);
     glfwSetKeyCallback(window, glfw_ev_key_callback);
     glfwSetMouseButtonCallback(window, glfw_ev_mouse_button_callback);
     glfwSetCursorPosCallback(window, glfw_ev_cursor_position_callback);
+    glfwSetScrollCallback(window, glfw_ev_scroll_callback);
 }
 
 void WindowImpl::glfw_ev_key_callback(GLFWwindow *window, int key, int scancode,
                                       int action, int mods) {
-
     auto impl = static_cast<WindowImpl *>(glfwGetWindowUserPointer(window));
-
-    auto disp = impl->pending_dispatcher;
-    if (disp == nullptr)
-        return;
-
-    window_event::Action ev_action;
-
-    switch (action) {
-    case GLFW_PRESS:
-    case GLFW_REPEAT:
-        ev_action = window_event::Action::PRESS;
-        break;
-    case GLFW_RELEASE:
-        ev_action = window_event::Action::RELEASE;
-        break;
-    }
-
-    auto event = std::make_shared<window_event::Key>(key, ev_action);
-    disp->queue_last(std::move(event));
-
-    impl->n_queued++;
+    impl->push_input({.type = InputRecord::Type::KEY,
+                      .time = glfwGetTime(),
+                      .code = key,
+                      .action = action,
+                      .x = 0,
+                      .y = 0});
 }
 
 void WindowImpl::glfw_ev_mouse_button_callback(GLFWwindow *window, int button,
                                                int action, int mods) {
     auto impl = static_cast<WindowImpl *>(glfwGetWindowUserPointer(window));
+    impl->push_input({.type = InputRecord::Type::MOUSE_BUTTON,
+                      .time = glfwGetTime(),
+                      .code = button,
+                      .action = action,
+                      .x = 0,
+                      .y = 0});
+}
 
-    auto disp = impl->pending_dispatcher;
-    if (disp == nullptr)
-        return;
+void WindowImpl::glfw_ev_cursor_position_callback(GLFWwindow *window,
+                                                  double xpos, double ypos) {
+    auto impl = static_cast<WindowImpl *>(glfwGetWindowUserPointer(window));
+    impl->push_input({.type = InputRecord::Type::CURSOR,
+                      .time = glfwGetTime(),
+                      .code = 0,
+                      .action = 0,
+                      .x = xpos,
+                      .y = ypos});
+}
 
-    window_event::Action ev_action;
+void WindowImpl::glfw_ev_scroll_callback(GLFWwindow *window, double xoffset,
+                                         double yoffset) {
+    auto impl = static_cast<WindowImpl *>(glfwGetWindowUserPointer(window));
+    impl->push_input({.type = InputRecord::Type::SCROLL,
+                      .time = glfwGetTime(),
+                      .code = 0,
+                      .action = 0,
+                      .x = xoffset,
+                      .y = yoffset});
+}
 
-    switch (action) {
-    case GLFW_PRESS:
-    case GLFW_REPEAT:
-        ev_action = window_event::Action::PRESS;
-        break;
-    case GLFW_RELEASE:
-        ev_action = window_event::Action::RELEASE;
-        break;
+void WindowImpl::push_input(const InputRecord &record) {
+    if (input_size != 0) {
+        auto &last =
+            input_ring[(input_head + input_size - 1) % INPUT_RING_CAPACITY];
+        // only the latest position matters
+        if (record.type == InputRecord::Type::CURSOR &&
+            last.type == InputRecord::Type::CURSOR) {
+            last = record;
+            return;
+        }
     }
 
-    window_event::MouseButtonClick::Button ev_button;
-
-    switch (button) {
-    case GLFW_MOUSE_BUTTON_LEFT:
-        ev_button = window_event::MouseButtonClick::Button::LEFT;
-        break;
-    case GLFW_MOUSE_BUTTON_RIGHT:
-        ev_button = window_event::MouseButtonClick::Button::RIGHT;
-        break;
-    case GLFW_MOUSE_BUTTON_MIDDLE:
-        ev_button = window_event::MouseButtonClick::Button::MIDDLE;
-        break;
+    if (input_size == INPUT_RING_CAPACITY) {
+        n_dropped_input++;
+#ifdef DEBUG
+        std::cerr << "WindowImpl: input ring full, dropped "
+                  << n_dropped_input << " records" << std::endl;
+#endif
+        return;
     }
 
-    auto event =
-        std::make_shared<window_event::MouseButtonClick>(ev_button, ev_action);
-    disp->queue_last(std::move(event));
-    impl->n_queued++;
+    input_ring[(input_head + input_size) % INPUT_RING_CAPACITY] = record;
+    input_size++;
 }
 
-void WindowImpl::glfw_ev_cursor_position_callback(GLFWwindow *window,
-                                                  double xpos, double ypos) {
-    auto impl = static_cast<WindowImpl *>(glfwGetWindowUserPointer(window));
+static window_event::Action to_event_action(int action) {
+    switch (action) {
+    case GLFW_RELEASE:
+        return window_event::Action::RELEASE;
+    case GLFW_PRESS:
+    case GLFW_REPEAT:
+    default:
+        return window_event::Action::PRESS;
+    }
+}
 
-    auto disp = impl->pending_dispatcher;
-    if (disp == nullptr)
-        return;
+std::size_t WindowImpl::drain_input(engine::EventDispatcher &disp) {
+    using Button = window_event::MouseButtonClick::Button;
+
+    std::size_t n_queued = 0;
+
+    for (; input_size != 0; input_size--) {
+        const auto &record = input_ring[input_head];
+        input_head = (input_head + 1) % INPUT_RING_CAPACITY;
+
+        switch (record.type) {
+        case InputRecord::Type::KEY:
+            disp.emplace_last<window_event::Key>(
+                record.code, to_event_action(record.action), record.time);
+            break;
+        case InputRecord::Type::MOUSE_BUTTON: {
+            Button button;
+            switch (record.code) {
+            case GLFW_MOUSE_BUTTON_LEFT:
+                button = Button::LEFT;
+                break;
+            case GLFW_MOUSE_BUTTON_RIGHT:
+                button = Button::RIGHT;
+                break;
+            case GLFW_MOUSE_BUTTON_MIDDLE:
+                button = Button::MIDDLE;
+                break;
+            default:
+                // no event for the extra buttons
+                continue;
+            }
+            disp.emplace_last<window_event::MouseButtonClick>(
+                button, to_event_action(record.action), record.time);
+            break;
+        }
+        case InputRecord::Type::CURSOR:
+            disp.emplace_last<window_event::MouseMoveEvent>(
+                static_cast<std::size_t>(record.x),
+                static_cast<std::size_t>(record.y), record.time);
+            break;
+        case InputRecord::Type::SCROLL:
+            disp.emplace_last<window_event::Scroll>(record.x, record.y,
+                                                    record.time);
+            break;
+        }
+        n_queued++;
+    }
 
-    auto event = std::make_shared<window_event::MouseMoveEvent>(
-        static_cast<std::size_t>(xpos), static_cast<std::size_t>(ypos));
-    disp->queue_last(std::move(event));
-    impl->n_queued++;
+    return n_queued;
 }
 
 WindowImpl::WindowImpl(const WindowConfig &conf) {
@@ -186,15 +248,36 @@ void *WindowImpl::getNativeHandle() const { return window; }
 
 std::size_t WindowImpl::feed_dispatcher(engine::EventDispatcher &disp,
                                         bool can_block) {
-    pending_dispatcher = &disp;
-    n_queued = 0;
-    if (can_block)
+    if (can_block && input_size == 0)
         glfwWaitEvents();
     else
         glfwPollEvents();
 
-    this->pending_dispatcher = nullptr;
-    return n_queued;
+    return drain_input(disp);
+}
+
+std::size_t WindowImpl::wait_until(
+    engine::EventDispatcher &disp,
+    engine::EventProducer::Clock::time_point deadline) {
+    using Clock = engine::EventProducer::Clock;
+
+    if (input_size != 0)
+        return drain_input(disp);
+
+    if (deadline == Clock::time_point::max()) {
+        glfwWaitEvents();
+    } else {
+        auto now = Clock::now();
+        if (deadline > now)
+            glfwWaitEventsTimeout(
+                std::chrono::duration<double>(deadline - now).count());
+        else
+            glfwPollEvents();
+    }
+
+    return drain_input(disp);
 }
 
+void WindowImpl::wake() { glfwPostEmptyEvent(); }
+
 } // namespace redseen::ui
@@ -67,6 +67,12 @@ class Window : public engine::EventProducer,
     std::size_t feed_dispatcher(engine::EventDispatcher &,
                                 bool can_block) override;
 
+    /** The window can sleep in the GLFW event loop */
+    bool can_wait() const override;
+    std::size_t wait_until(engine::EventDispatcher &,
+                           Clock::time_point deadline) override;
+    void wake() override;
+
   private:
     std::unique_ptr<WindowImpl> impl; // Use unique_ptr for PIMPL
 };
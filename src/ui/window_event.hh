@@ -20,51 +20,159 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string_view>
 
 #include <GLFW/glfw3.h>
 
 #include "engine/event.hh"
+#include "engine/event_key.hh"
+#include "engine/event_record.hh"
 
 namespace redseen::ui {
 
 namespace window_event {
 
-constexpr std::string_view MOUSE_MOVE = "window.mouse.move";
-constexpr std::string_view MOUSE_BUTTON_CLICK = "window.button.click";
-constexpr std::string_view FOCUS = "window.focus";
-constexpr std::string_view KEY = "window.key";
+inline const engine::EventKey MOUSE_MOVE{"window.mouse.move"};
+inline const engine::EventKey MOUSE_BUTTON_CLICK{"window.button.click"};
+inline const engine::EventKey FOCUS{"window.focus"};
+inline const engine::EventKey KEY{"window.key"};
+inline const engine::EventKey SCROLL{"window.scroll"};
 
 enum class Action { PRESS, RELEASE };
 
 struct WindowEvent : engine::Event {
-    using engine::Event::Event;
+    /** Time the input arrived at, in seconds of glfwGetTime() */
+    double timestamp;
+
+    WindowEvent(const engine::EventKey &key, double timestamp = 0)
+        : engine::Event(key), timestamp(timestamp) {}
 };
 
 struct MouseMoveEvent : WindowEvent {
     size_t x, y;
 
-    MouseMoveEvent(size_t x, size_t y) : WindowEvent(MOUSE_MOVE), x(x), y(y) {}
+    MouseMoveEvent(size_t x, size_t y, double timestamp = 0)
+        : WindowEvent(MOUSE_MOVE, timestamp), x(x), y(y) {}
+
+    static const engine::EventKey &event_key() { return MOUSE_MOVE; }
+
+    void serialize(engine::EventWriter &writer) const {
+        writer.write(std::uint64_t(x));
+        writer.write(std::uint64_t(y));
+        writer.write(timestamp);
+    }
+    static MouseMoveEvent deserialize(engine::EventReader &reader) {
+        auto x = reader.read<std::uint64_t>();
+        auto y = reader.read<std::uint64_t>();
+        auto timestamp = reader.read<double>();
+        return MouseMoveEvent(x, y, timestamp);
+    }
+
+    /** Observers only care about the latest position */
+    static constexpr engine::CoalescePolicy coalesce_policy =
+        engine::CoalescePolicy::KEEP_LAST;
 };
 
 struct MouseButtonClick : WindowEvent {
     enum class Button { LEFT = 0, RIGHT = 1, MIDDLE = 2 } button;
     Action action;
-    MouseButtonClick(Button button, Action action)
-        : WindowEvent(MOUSE_BUTTON_CLICK), button(button), action(action) {}
+    MouseButtonClick(Button button, Action action, double timestamp = 0)
+        : WindowEvent(MOUSE_BUTTON_CLICK, timestamp), button(button),
+          action(action) {}
+
+    static const engine::EventKey &event_key() { return MOUSE_BUTTON_CLICK; }
+
+    void serialize(engine::EventWriter &writer) const {
+        writer.write(button);
+        writer.write(action);
+        writer.write(timestamp);
+    }
+    static MouseButtonClick deserialize(engine::EventReader &reader) {
+        auto button = reader.read<Button>();
+        auto action = reader.read<Action>();
+        auto timestamp = reader.read<double>();
+        return MouseButtonClick(button, action, timestamp);
+    }
 };
 
 struct Focus : WindowEvent {
-    Focus() : WindowEvent(FOCUS) {}
+    Focus(double timestamp = 0) : WindowEvent(FOCUS, timestamp) {}
+
+    static const engine::EventKey &event_key() { return FOCUS; }
+
+    void serialize(engine::EventWriter &writer) const {
+        writer.write(timestamp);
+    }
+    static Focus deserialize(engine::EventReader &reader) {
+        return Focus(reader.read<double>());
+    }
 };
 
 struct Key : WindowEvent {
     int key;
     Action action;
 
-    Key(int key, Action action) : WindowEvent(KEY), key(key), action(action) {}
+    Key(int key, Action action, double timestamp = 0)
+        : WindowEvent(KEY, timestamp), key(key), action(action) {}
+
+    static const engine::EventKey &event_key() { return KEY; }
+
+    void serialize(engine::EventWriter &writer) const {
+        writer.write(key);
+        writer.write(action);
+        writer.write(timestamp);
+    }
+    static Key deserialize(engine::EventReader &reader) {
+        auto key = reader.read<int>();
+        auto action = reader.read<Action>();
+        auto timestamp = reader.read<double>();
+        return Key(key, action, timestamp);
+    }
 };
 
+struct Scroll : WindowEvent {
+    /** Scroll offsets, summed over the scrolls merged into the event */
+    double dx, dy;
+
+    Scroll(double dx, double dy, double timestamp = 0)
+        : WindowEvent(SCROLL, timestamp), dx(dx), dy(dy) {}
+
+    static const engine::EventKey &event_key() { return SCROLL; }
+
+    void serialize(engine::EventWriter &writer) const {
+        writer.write(dx);
+        writer.write(dy);
+        writer.write(timestamp);
+    }
+    static Scroll deserialize(engine::EventReader &reader) {
+        auto dx = reader.read<double>();
+        auto dy = reader.read<double>();
+        auto timestamp = reader.read<double>();
+        return Scroll(dx, dy, timestamp);
+    }
+
+    /** Fold a later scroll into this one */
+    void coalesce(const Scroll &newer) {
+        dx += newer.dx;
+        dy += newer.dy;
+        timestamp = newer.timestamp;
+    }
+
+    /** Observers want the whole distance scrolled, not every step */
+    static constexpr engine::CoalescePolicy coalesce_policy =
+        engine::CoalescePolicy::ACCUMULATE;
+};
+
+// recordable by EventRecorder, also where no window is created, like in
+// headless replays
+inline const engine::EventCodecRegistration<MouseMoveEvent> MOUSE_MOVE_CODEC;
+inline const engine::EventCodecRegistration<MouseButtonClick>
+    MOUSE_BUTTON_CLICK_CODEC;
+inline const engine::EventCodecRegistration<Focus> FOCUS_CODEC;
+inline const engine::EventCodecRegistration<Key> KEY_CODEC;
+inline const engine::EventCodecRegistration<Scroll> SCROLL_CODEC;
+
 } // namespace window_event
 
 using window_event::WindowEvent;
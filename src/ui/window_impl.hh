@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <GLFW/glfw3.h>
 
@@ -39,14 +41,46 @@ class WindowImpl {
     void *getNativeHandle() const;
 
     std::size_t feed_dispatcher(engine::EventDispatcher &, bool can_block);
+    std::size_t wait_until(engine::EventDispatcher &,
+                           engine::EventProducer::Clock::time_point deadline);
+    void wake();
 
   private:
     GLFWwindow *window = nullptr;
     std::shared_ptr<render::OpenGLDrawer> drawer;
     bool visible;
 
-    engine::EventDispatcher *pending_dispatcher = nullptr;
-    std::size_t n_queued = 0;
+    /** Input as delivered by GLFW, turned into events by feed_dispatcher */
+    struct InputRecord {
+        enum class Type : std::uint8_t {
+            KEY,
+            MOUSE_BUTTON,
+            CURSOR,
+            SCROLL
+        } type;
+        /** glfwGetTime() at arrival */
+        double time;
+        /** GLFW key or mouse button */
+        int code;
+        /** GLFW action */
+        int action;
+        /** Cursor position or scroll offsets */
+        double x, y;
+    };
+
+    static constexpr std::size_t INPUT_RING_CAPACITY = 1024;
+
+    /** Input collected whenever GLFW processes events, so nothing is lost
+     * between feeds and the callbacks don't allocate */
+    std::array<InputRecord, INPUT_RING_CAPACITY> input_ring;
+    std::size_t input_head = 0;
+    std::size_t input_size = 0;
+    /** Records dropped because the ring was full */
+    std::uint64_t n_dropped_input = 0;
+
+    void push_input(const InputRecord &record);
+    /** Queue events for the collected input */
+    std::size_t drain_input(engine::EventDispatcher &);
 
     void init_callbacks();
 
@@ -58,6 +92,9 @@ class WindowImpl {
 
     static void glfw_ev_cursor_position_callback(GLFWwindow *window,
                                                  double xpos, double ypos);
+
+    static void glfw_ev_scroll_callback(GLFWwindow *window, double xoffset,
+                                        double yoffset);
 };
 
 } // namespace redseen::ui
@@ -0,0 +1,124 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Checks of the queues under the dispatcher: RingDeque keeps its order
+// across growth and wrapping, MpscQueue neither loses nor duplicates values
+// pushed from several threads.
+
+#include <cassert>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "common/mpsc_queue.hh"
+#include "common/ring_deque.hh"
+
+using namespace redseen;
+
+namespace {
+
+void test_ring_deque() {
+    RingDeque<int> deque;
+    assert(deque.empty());
+
+    // wrap the head around before growing
+    for (int i = 0; i < 10; i++)
+        deque.push_back(i);
+    for (int i = 0; i < 8; i++)
+        deque.pop_front();
+    for (int i = 10; i < 40; i++)
+        deque.push_back(i);
+    deque.push_front(7);
+    deque.push_front(6);
+
+    assert(deque.size() == 34);
+    for (std::size_t i = 0; i < deque.size(); i++)
+        assert(deque[i] == int(i) + 6);
+    assert(deque.front() == 6);
+    assert(deque.back() == 39);
+
+    const auto capacity = deque.capacity();
+    deque.clear();
+    assert(deque.empty());
+    // the memory is kept for reuse
+    assert(deque.capacity() == capacity);
+}
+
+void test_mpsc_queue_bounds() {
+    // rounded up to a power of two
+    MpscQueue<int> queue(5);
+    assert(queue.capacity() == 8);
+    assert(queue.empty());
+
+    for (int i = 0; i < 8; i++)
+        assert(queue.try_push(i));
+    assert(!queue.try_push(8));
+
+    int value;
+    for (int i = 0; i < 8; i++) {
+        assert(queue.try_pop(value));
+        assert(value == i);
+    }
+    assert(!queue.try_pop(value));
+    assert(queue.empty());
+}
+
+void test_mpsc_queue_threads() {
+    constexpr int N_PRODUCERS = 4;
+    constexpr int N_VALUES = 20000;
+    MpscQueue<int> queue(64);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < N_PRODUCERS; p++) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < N_VALUES; i++) {
+                while (!queue.try_push(p * N_VALUES + i))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    // the values of each producer come out in the order they were pushed
+    std::vector<int> next(N_PRODUCERS, 0);
+    int n_popped = 0;
+    while (n_popped < N_PRODUCERS * N_VALUES) {
+        int value;
+        if (!queue.try_pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        auto producer = value / N_VALUES;
+        assert(value % N_VALUES == next[producer]);
+        next[producer]++;
+        n_popped++;
+    }
+
+    for (auto &producer : producers)
+        producer.join();
+    assert(queue.empty());
+}
+
+} // namespace
+
+int main() {
+    test_ring_deque();
+    test_mpsc_queue_bounds();
+    test_mpsc_queue_threads();
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Checks of the tick semantics of coroutines: a delay of n resumes on the
+// nth tick, and a task resumed by a tick only sees the ticks after it.
+
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "engine/coroutine.hh"
+#include "engine/event_dispatcher.hh"
+
+using namespace redseen::engine;
+
+namespace {
+
+inline const EventKey TICK_TEST{"test.tick"};
+inline const EventKey PING_TEST{"test.ping"};
+
+struct Ping : Event {
+    int value;
+
+    explicit Ping(int value) : Event(PING_TEST), value(value) {}
+    static const EventKey &event_key() { return PING_TEST; }
+};
+
+/** Ticks dispatched so far, seen by the tasks */
+int now = 0;
+
+void tick(EventDispatcher &disp) {
+    now++;
+    disp.emplace_last<Event>(TICK_TEST);
+    disp.dispatch();
+}
+
+Task delay_then_tick(std::vector<int> &log) {
+    co_await delay(2);
+    log.push_back(now);
+    // the tick which ended the delay is already being dispatched
+    co_await next_event(TICK_TEST);
+    log.push_back(now);
+    co_await delay(0);
+    log.push_back(now);
+}
+
+void test_delay() {
+    EventDispatcher disp;
+    auto scheduler = CoroutineScheduler::create(TICK_TEST);
+    scheduler->attach(disp);
+    now = 0;
+
+    std::vector<int> log;
+    scheduler->spawn(delay_then_tick(log));
+    assert(scheduler->get_task_count() == 1);
+
+    for (int i = 0; i < 4; i++)
+        tick(disp);
+    assert((log == std::vector<int>{2, 3, 3}));
+    assert(scheduler->get_task_count() == 0);
+}
+
+Task wait_for_ping(std::vector<int> &log) {
+    log.push_back(0);
+    const Ping &ping = co_await next_event<Ping>();
+    log.push_back(ping.value);
+}
+
+void test_typed_event() {
+    EventDispatcher disp;
+    auto scheduler = CoroutineScheduler::create(TICK_TEST);
+    scheduler->attach(disp);
+
+    std::vector<int> log;
+    scheduler->spawn(wait_for_ping(log));
+    // runs until the first suspension right away
+    assert((log == std::vector<int>{0}));
+
+    // of the key, but not a Ping
+    disp.emplace_last<Event>(PING_TEST);
+    disp.dispatch();
+    assert(scheduler->get_task_count() == 1);
+
+    disp.emplace_last<Ping>(7);
+    disp.emplace_last<Ping>(8);
+    disp.dispatch();
+    assert((log == std::vector<int>{0, 7}));
+    assert(scheduler->get_task_count() == 0);
+}
+
+Task throw_on_tick() {
+    co_await next_event(TICK_TEST);
+    throw std::runtime_error("task failed");
+}
+
+void test_exception() {
+    EventDispatcher disp;
+    auto scheduler = CoroutineScheduler::create(TICK_TEST);
+    scheduler->attach(disp);
+    scheduler->spawn(throw_on_tick());
+
+    bool thrown = false;
+    try {
+        tick(disp);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(scheduler->get_task_count() == 0);
+}
+
+} // namespace
+
+int main() {
+    test_delay();
+    test_typed_event();
+    test_exception();
+    return 0;
+}
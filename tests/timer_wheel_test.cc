@@ -0,0 +1,138 @@
+/*
+ *  Copyright (C) 2025 Grzegorz Kociołek (grzegorz.kclk@gmail.com)
+ *
+ *  This file is a part of RedSeen; a 3D game engine.
+ *
+ *  RedSeen is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RedSeen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Checks of the hierarchical timing wheel: timers fire on their due tick
+// whichever level they start in, and next_deadline() reports the cascades.
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "engine/event_dispatcher.hh"
+#include "engine/timer_wheel.hh"
+
+using namespace redseen::engine;
+using namespace std::chrono_literals;
+
+namespace {
+
+inline const EventKey TIMER_TEST{"test.timer"};
+
+/** Advance to the tick before the due one, then over it */
+void expect_fires_at(TimerWheel &wheel, EventDispatcher &disp,
+                     std::uint64_t &now, std::uint64_t due) {
+    assert(wheel.advance(disp, due - 1 - now) == 0);
+    assert(wheel.advance(disp, 1) == 1);
+    now = due;
+    disp.drop_queue();
+}
+
+void test_cascade() {
+    TimerWheel wheel(1ms);
+    EventDispatcher disp;
+    std::uint64_t now = 0;
+
+    // one timer starting in each of the 4 levels
+    const std::uint64_t dues[] = {
+        5,
+        TimerWheel::N_SLOTS + 44,
+        (std::uint64_t(1) << 16) + 1234,
+        (std::uint64_t(1) << 24) + 777,
+    };
+    for (auto due : dues)
+        wheel.schedule_after(std::chrono::milliseconds(due),
+                             std::make_shared<Event>(TIMER_TEST));
+    assert(wheel.get_pending_count() == std::size(dues));
+
+    for (auto due : dues)
+        expect_fires_at(wheel, disp, now, due);
+    assert(wheel.get_pending_count() == 0);
+}
+
+void test_cancel() {
+    TimerWheel wheel(1ms);
+    EventDispatcher disp;
+
+    auto handle =
+        wheel.schedule_after(70000ms, std::make_shared<Event>(TIMER_TEST));
+    assert(wheel.is_scheduled(handle));
+    assert(wheel.cancel(handle));
+    assert(!wheel.cancel(handle));
+    assert(!wheel.is_scheduled(handle));
+
+    // the freed timer is reused, the old handle must not reach it
+    auto other =
+        wheel.schedule_after(10ms, std::make_shared<Event>(TIMER_TEST));
+    assert(!wheel.cancel(handle));
+    assert(wheel.is_scheduled(other));
+    assert(wheel.advance(disp, 70000) == 1);
+}
+
+void test_periodic() {
+    TimerWheel wheel(1ms);
+    EventDispatcher disp;
+
+    auto handle =
+        wheel.schedule_every(10ms, std::make_shared<Event>(TIMER_TEST));
+    assert(wheel.advance(disp, 9) == 0);
+    assert(wheel.advance(disp, 1) == 1);
+    assert(wheel.advance(disp, 25) == 2);
+    assert(wheel.cancel(handle));
+    assert(wheel.advance(disp, 100) == 0);
+}
+
+void test_next_deadline() {
+    TimerWheel wheel(1ms);
+    EventDispatcher disp;
+    assert(wheel.next_deadline() == TimerWheel::Clock::time_point::max());
+
+    // the start of the wheel isn't exposed, find it through a timer due on
+    // the first tick
+    auto first =
+        wheel.schedule_after(1ms, std::make_shared<Event>(TIMER_TEST));
+    const auto start = wheel.next_deadline() - 1ms;
+    wheel.cancel(first);
+
+    // due in a coarser slot, the wheel has to wake up for the cascade first
+    wheel.schedule_after(300ms, std::make_shared<Event>(TIMER_TEST));
+    assert(wheel.next_deadline() ==
+           start + std::chrono::milliseconds(TimerWheel::N_SLOTS));
+
+    assert(wheel.advance(disp, TimerWheel::N_SLOTS) == 0);
+    assert(wheel.next_deadline() == start + 300ms);
+
+    // an earlier timer in the finest level comes first
+    wheel.schedule_after(10ms, std::make_shared<Event>(TIMER_TEST));
+    assert(wheel.next_deadline() ==
+           start + std::chrono::milliseconds(TimerWheel::N_SLOTS + 10));
+
+    assert(wheel.advance(disp, 300 - TimerWheel::N_SLOTS) == 2);
+    assert(wheel.next_deadline() == TimerWheel::Clock::time_point::max());
+}
+
+} // namespace
+
+int main() {
+    test_cascade();
+    test_cancel();
+    test_periodic();
+    test_next_deadline();
+    return 0;
+}